@@ -0,0 +1,325 @@
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include "BlobLabeller.h"
+#include "ColorFilter.h"
+#include "FrameProcessor.h"
+#include "JpegDecoder.h"
+#include "ReplaySource.h"
+#include "Reprojection.h"
+#include "Pantiltzoom/pantiltzoom.h"
+#include "../Position/PositionServer/shared-value.h"
+
+// Microbenchmarks of the hot paths of the detection and of the position
+// server, on the frames of a directory (see ReplaySource) and on synthetic
+// frames :
+//     benchmarks [--images=<directory>] [--width=<pixels>] [--height=<pixels>]
+//                [--threshold=<threshold>] [<benchmark options>]
+// The directory is src/Detection/PlayGround by default, and the synthetic
+// frames are 704x576 (the size of the Axis frames). The usual options of
+// the Google benchmark library apply, for instance :
+//     --benchmark_filter=<regex>    benchmarks to run
+//     --benchmark_format=json       machine readable results on stdout
+//     --benchmark_out=<file> --benchmark_out_format=json
+//
+// The benchmarks on frames take the frame set as argument : 0 for the
+// synthetic frame, 1 for the recorded ones, used in turn. Their throughput
+// is in pixels per second.
+
+void loggerInit(char* argv0) {
+    google::InitGoogleLogging(argv0);
+    FLAGS_logtostderr = 1;
+    FLAGS_minloglevel = 1;
+}
+
+namespace {
+
+std::string imageDirectory("src/Detection/PlayGround");
+int frameWidth = 704, frameHeight = 576;
+int threshold = 35;
+
+// Frames and masks of each set, JPEG files of the directory.
+std::vector<FrameBuffer::Ptr> frames[2];
+std::vector<std::vector<unsigned char> > masks[2];
+std::vector<std::vector<unsigned char> > jpegs;
+
+// Dark noisy background, below any sensible threshold, with green
+// squares, reproducible.
+FrameBuffer::Ptr syntheticFrame(int width, int height) {
+    FrameBuffer::Ptr frame(new FrameBuffer());
+    frame->image.resize(mirage::img::Coordinate(width, height));
+    unsigned char* pixels = imageBytes(frame->image);
+    unsigned int seed = 12345;
+    for (std::size_t i = 0; i < 3 * (std::size_t)width * height; ++i) {
+        seed = seed * 1103515245 + 12345;
+        pixels[i] = 40 + (seed >> 16) % 16;
+    }
+    for (int k = 0; k < 8; ++k) {
+        int x0 = (k * 97) % std::max(1, width - 24), y0 = (k * 61) % std::max(1, height - 24);
+        for (int y = y0; y < std::min(height, y0 + 20); ++y)
+            for (int x = x0; x < std::min(width, x0 + 20); ++x) {
+                unsigned char* p = pixels + 3 * ((std::size_t)y * width + x);
+                p[0] = 30;
+                p[1] = 200;
+                p[2] = 40;
+            }
+    }
+    frame->bgr = false;
+    frame->pan = 30;
+    frame->tilt = -30;
+    frame->zoom = 1998;
+    return frame;
+}
+
+void readFile(const std::string& path, std::vector<unsigned char>& bytes) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return;
+    unsigned char chunk[65536];
+    std::size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+        bytes.insert(bytes.end(), chunk, chunk + n);
+    std::fclose(file);
+}
+
+void load() {
+    frames[0].push_back(syntheticFrame(frameWidth, frameHeight));
+    ReplaySource source(imageDirectory);
+    while (FrameBuffer::Ptr frame = source.next()) {
+        frames[1].push_back(frame);
+        jpegs.push_back(std::vector<unsigned char>());
+        readFile(source.path(frame->sequence), jpegs.back());
+    }
+    for (int set = 0; set < 2; ++set)
+        for (std::size_t i = 0; i < frames[set].size(); ++i) {
+            mirage::img::Coordinate size = frames[set][i]->image._dimension;
+            masks[set].push_back(std::vector<unsigned char>(size[0] * size[1]));
+            ColorFilter::greenMask(imageBytes(frames[set][i]->image), &masks[set].back()[0], 0,
+                                   size[0] * size[1], threshold);
+        }
+}
+
+std::size_t nbPixels(const FrameBuffer::Ptr& frame) {
+    return (std::size_t)frame->image._dimension[0] * frame->image._dimension[1];
+}
+
+// Frame set of the argument, false if it is empty.
+bool frameSet(benchmark::State& state, std::vector<FrameBuffer::Ptr>*& set) {
+    set = &frames[state.range(0)];
+    if (set->empty())
+        state.SkipWithError(("no frame in " + imageDirectory).c_str());
+    state.SetLabel(state.range(0) == 0 ? "synthetic" : "recorded");
+    return !set->empty();
+}
+
+void GreenMask(benchmark::State& state) {
+    std::vector<FrameBuffer::Ptr>* set;
+    if (!frameSet(state, set))
+        return;
+    std::vector<unsigned char> mask;
+    std::size_t i = 0, pixels = 0;
+    for (auto _ : state) {
+        FrameBuffer::Ptr& frame = (*set)[i++ % set->size()];
+        mask.resize(nbPixels(frame));
+        ColorFilter::greenMask(imageBytes(frame->image), &mask[0], 0, nbPixels(frame), threshold);
+        pixels += nbPixels(frame);
+    }
+    state.SetItemsProcessed(pixels);
+    state.SetLabel(std::string(state.range(0) == 0 ? "synthetic " : "recorded ")
+                   + ColorFilter::implementation());
+}
+BENCHMARK(GreenMask)->Arg(0)->Arg(1);
+
+// What FrameCapturer::rgb2bgr runs on each bitmap frame. The frames are
+// left swapped or not, which does not change their mask.
+void Rgb2Bgr(benchmark::State& state) {
+    std::vector<FrameBuffer::Ptr>* set;
+    if (!frameSet(state, set))
+        return;
+    std::size_t i = 0, pixels = 0;
+    for (auto _ : state) {
+        FrameBuffer::Ptr& frame = (*set)[i++ % set->size()];
+        ColorFilter::swapRedBlue(imageBytes(frame->image), nbPixels(frame));
+        pixels += nbPixels(frame);
+    }
+    state.SetItemsProcessed(pixels);
+}
+BENCHMARK(Rgb2Bgr)->Arg(0)->Arg(1);
+
+void FilterColor(benchmark::State& state) {
+    std::vector<FrameBuffer::Ptr>* set;
+    if (!frameSet(state, set))
+        return;
+    FrameProcessor processor;
+    std::size_t i = 0, pixels = 0;
+    for (auto _ : state) {
+        FrameBuffer::Ptr& frame = (*set)[i++ % set->size()];
+        processor.setFrame(frame);
+        processor.filterColor(threshold);
+        pixels += nbPixels(frame);
+    }
+    state.SetItemsProcessed(pixels);
+}
+BENCHMARK(FilterColor)->Arg(0)->Arg(1);
+
+// Labelling, size filter and reprojection of the blobs.
+void FindPositions(benchmark::State& state) {
+    std::vector<FrameBuffer::Ptr>* set;
+    if (!frameSet(state, set))
+        return;
+    std::vector<FrameProcessor> processors(set->size());
+    for (std::size_t i = 0; i < set->size(); ++i) {
+        processors[i].setFrame((*set)[i]);
+        processors[i].filterColor(threshold);
+    }
+    std::size_t i = 0, pixels = 0;
+    for (auto _ : state) {
+        std::size_t k = i++ % set->size();
+        benchmark::DoNotOptimize(processors[k].findPositions());
+        pixels += nbPixels((*set)[k]);
+    }
+    state.SetItemsProcessed(pixels);
+}
+BENCHMARK(FindPositions)->Arg(0)->Arg(1);
+
+void Labeller(benchmark::State& state) {
+    std::vector<FrameBuffer::Ptr>* set;
+    if (!frameSet(state, set))
+        return;
+    std::vector<std::vector<unsigned char> >& maskSet = masks[state.range(0)];
+    BlobLabeller labeller;
+    std::size_t i = 0, pixels = 0;
+    for (auto _ : state) {
+        std::size_t k = i++ % set->size();
+        mirage::img::Coordinate size = (*set)[k]->image._dimension;
+        benchmark::DoNotOptimize(labeller(&maskSet[k][0], size[0], size[1]).size());
+        pixels += nbPixels((*set)[k]);
+    }
+    state.SetItemsProcessed(pixels);
+}
+BENCHMARK(Labeller)->Arg(0)->Arg(1);
+
+// Pixel to (pan, tilt) of 64 blob centers, with the original function and
+// with Reprojection.
+const int nbCenters = 64;
+
+void Pantiltzoom(benchmark::State& state) {
+    double pan, tilt;
+    for (auto _ : state)
+        for (int k = 0; k < nbCenters; ++k) {
+            pantiltzoom(&pan, &tilt, 10 * k, 5 * k, 352, 288, 30, -30, 1998);
+            benchmark::DoNotOptimize(pan);
+            benchmark::DoNotOptimize(tilt);
+        }
+    state.SetItemsProcessed(state.iterations() * nbCenters);
+}
+BENCHMARK(Pantiltzoom);
+
+void ReprojectionBatch(benchmark::State& state) {
+    double u[nbCenters], v[nbCenters], pan[nbCenters], tilt[nbCenters];
+    for (int k = 0; k < nbCenters; ++k) {
+        u[k] = 10 * k;
+        v[k] = 5 * k;
+    }
+    for (auto _ : state) {
+        Reprojection reprojection(30, -30, 1998, 352, 288, *Calibration::standard());
+        reprojection.toPanTilt(u, v, pan, tilt, nbCenters);
+        benchmark::DoNotOptimize(pan[0]);
+    }
+    state.SetItemsProcessed(state.iterations() * nbCenters);
+}
+BENCHMARK(ReprojectionBatch);
+
+// Recorded frames, at 1/scale of their size.
+void JpegDecode(benchmark::State& state) {
+    if (jpegs.empty()) {
+        state.SkipWithError(("no frame in " + imageDirectory).c_str());
+        return;
+    }
+    JpegDecoder decoder;
+    ImageRGB image;
+    std::size_t i = 0, bytes = 0;
+    for (auto _ : state) {
+        std::vector<unsigned char>& jpeg = jpegs[i++ % jpegs.size()];
+        decoder.decode(&jpeg[0], jpeg.size(), image, state.range(0));
+        bytes += jpeg.size();
+    }
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(JpegDecode)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+unsigned int maxThreads() {
+    return std::max(2u, std::thread::hardware_concurrency());
+}
+
+SharedValue sharedValue;
+
+void SharedValuePut(benchmark::State& state) {
+    Data d(state.thread_index(), Point(1, 2));
+    for (auto _ : state)
+        sharedValue += d;
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(SharedValuePut)->ThreadRange(1, maxThreads())->UseRealTime();
+
+void SharedValueGet(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        sharedValue.setCapacity(1000);
+        for (int i = 0; i < 1000; ++i)
+            sharedValue += Data(i, Point(i, i));
+    }
+    for (auto _ : state)
+        benchmark::DoNotOptimize(sharedValue().size());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(SharedValueGet)->ThreadRange(1, maxThreads())->UseRealTime();
+
+// Thread 0 puts, the others get.
+void SharedValueGetWhilePut(benchmark::State& state) {
+    Data d(state.thread_index(), Point(1, 2));
+    for (auto _ : state) {
+        if (state.thread_index() == 0)
+            sharedValue += d;
+        else
+            benchmark::DoNotOptimize(sharedValue().size());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(SharedValueGetWhilePut)->ThreadRange(2, maxThreads())->UseRealTime();
+
+}
+
+int main(int argc, char* argv[]) {
+    loggerInit(argv[0]);
+
+    // Own options, the others are left to the library.
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option.compare(0, 9, "--images=") == 0)
+            imageDirectory = option.substr(9);
+        else if (option.compare(0, 8, "--width=") == 0)
+            frameWidth = atoi(option.c_str() + 8);
+        else if (option.compare(0, 9, "--height=") == 0)
+            frameHeight = atoi(option.c_str() + 9);
+        else if (option.compare(0, 12, "--threshold=") == 0)
+            threshold = atoi(option.c_str() + 12);
+        else
+            argv[kept++] = argv[i];
+    }
+    argc = kept;
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    load();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
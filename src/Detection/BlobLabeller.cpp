@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+#include "BlobLabeller.h"
+
+BlobLabeller::BlobLabeller(int minExtent)
+    :minExtent(minExtent), previous(), current(), parent(), sums(), found(), nbLabels(0)
+{
+}
+
+unsigned int BlobLabeller::newLabel() {
+    unsigned int label = parent.size();
+    parent.push_back(label);
+    Sums s;
+    s.area = s.x = s.y = s.xx = s.yy = s.xy = 0;
+    s.minX = s.minY = 0x7fffffff;
+    s.maxX = s.maxY = -1;
+    sums.push_back(s);
+    return label;
+}
+
+unsigned int BlobLabeller::find(unsigned int label) {
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]]; // path halving
+        label = parent[label];
+    }
+    return label;
+}
+
+// The smallest label, i.e. the first one met in the scan, stays the root.
+unsigned int BlobLabeller::merge(unsigned int a, unsigned int b) {
+    a = find(a);
+    b = find(b);
+    if (a == b)
+        return a;
+    if (b < a)
+        std::swap(a, b);
+    parent[b] = a;
+    return a;
+}
+
+// Runs of non zero bytes, background being skipped 8 bytes at a time.
+void BlobLabeller::scanRow(const unsigned char* row, int width) {
+    current.clear();
+    int x = 0;
+    while (x < width) {
+        while (x + 8 <= width) {
+            uint64_t word;
+            std::memcpy(&word, row + x, 8);
+            if (word != 0)
+                break;
+            x += 8;
+        }
+        while (x < width && row[x] == 0)
+            ++x;
+        if (x == width)
+            break;
+        Run run;
+        run.start = x;
+        while (x < width && row[x] != 0)
+            ++x;
+        run.end = x - 1;
+        run.label = 0;
+        current.push_back(run);
+    }
+}
+
+void BlobLabeller::add(const Run& run, int y) {
+    Sums& s = sums[run.label];
+    double n = run.end - run.start + 1;
+    double a = run.start - 1, b = run.end;
+    // Sums of x and x*x for x in [start, end].
+    double sx = n * (run.start + run.end) / 2;
+    double sxx = (b * (b + 1) * (2 * b + 1) - a * (a + 1) * (2 * a + 1)) / 6;
+    s.area += n;
+    s.x += sx;
+    s.y += n * y;
+    s.xx += sxx;
+    s.yy += n * y * y;
+    s.xy += sx * y;
+    if (run.start < s.minX) s.minX = run.start;
+    if (run.end > s.maxX) s.maxX = run.end;
+    if (y < s.minY) s.minY = y;
+    if (y > s.maxY) s.maxY = y;
+}
+
+const std::vector<BlobLabeller::Blob>& BlobLabeller::operator()(const unsigned char* mask, int width, int height,
+                                                                std::size_t stride) {
+    if (stride == 0)
+        stride = width;
+    previous.clear();
+    parent.clear();
+    sums.clear();
+    found.clear();
+
+    for (int y = 0; y < height; ++y) {
+        scanRow(mask + y * stride, width);
+
+        // Both rows are sorted : the runs of the previous row touching a
+        // run (8 neighbors : overlapping [start - 1, end + 1]) are found
+        // by walking the two lists together.
+        std::size_t p = 0;
+        for (std::size_t i = 0; i < current.size(); ++i) {
+            Run& run = current[i];
+            while (p < previous.size() && previous[p].end < run.start - 1)
+                ++p;
+            bool labelled = false;
+            std::size_t q = p;
+            for (; q < previous.size() && previous[q].start <= run.end + 1; ++q) {
+                if (labelled)
+                    run.label = merge(run.label, previous[q].label);
+                else {
+                    run.label = previous[q].label;
+                    labelled = true;
+                }
+            }
+            // The last touching run may also touch the next run.
+            if (q > p)
+                p = q - 1;
+            if (!labelled)
+                run.label = newLabel();
+            add(run, y);
+        }
+        previous.swap(current);
+    }
+
+    // Sums of the merged labels go to their root.
+    nbLabels = 0;
+    for (unsigned int label = 0; label < parent.size(); ++label) {
+        unsigned int root = find(label);
+        if (root == label) {
+            ++nbLabels;
+            continue;
+        }
+        Sums& s = sums[label];
+        Sums& r = sums[root];
+        r.area += s.area;
+        r.x += s.x;
+        r.y += s.y;
+        r.xx += s.xx;
+        r.yy += s.yy;
+        r.xy += s.xy;
+        if (s.minX < r.minX) r.minX = s.minX;
+        if (s.maxX > r.maxX) r.maxX = s.maxX;
+        if (s.minY < r.minY) r.minY = s.minY;
+        if (s.maxY > r.maxY) r.maxY = s.maxY;
+    }
+
+    // Roots are met in increasing order, which is the order of the first
+    // pixel of each component.
+    for (unsigned int label = 0; label < parent.size(); ++label) {
+        if (parent[label] != label)
+            continue;
+        const Sums& s = sums[label];
+        if (s.maxX - s.minX <= minExtent || s.maxY - s.minY <= minExtent)
+            continue;
+        Blob blob;
+        blob.area = (unsigned int)s.area;
+        blob.minX = s.minX;
+        blob.minY = s.minY;
+        blob.maxX = s.maxX;
+        blob.maxY = s.maxY;
+        blob.cx = s.x / s.area;
+        blob.cy = s.y / s.area;
+        blob.mxx = s.xx / s.area - blob.cx * blob.cx;
+        blob.myy = s.yy / s.area - blob.cy * blob.cy;
+        blob.mxy = s.xy / s.area - blob.cx * blob.cy;
+        found.push_back(blob);
+    }
+    return found;
+}
@@ -0,0 +1,71 @@
+#ifndef BLOBLABELLER_H
+#define BLOBLABELLER_H
+
+#include <cstddef>
+#include <vector>
+
+// Single pass connected components labelling of a binary mask (8
+// neighbors), keeping per component only its moments : no pixel list and
+// no label image are built.
+//
+// The mask is scanned row by row as runs of foreground pixels. A run gets
+// the label of the runs of the previous row it touches, their labels
+// being merged with a union-find when there are several, and its sums are
+// added to its label. Memory is proportional to the number of runs of two
+// rows plus the number of labels.
+class BlobLabeller
+{
+    public:
+        struct Blob {
+            unsigned int area;            // pixels
+            int minX, minY, maxX, maxY;   // bounding box, inclusive
+            double cx, cy;                // centroid
+            double mxx, myy, mxy;         // central second moments, per pixel
+
+            double boxCenterX() const { return (minX + maxX) / 2.0; }
+            double boxCenterY() const { return (minY + maxY) / 2.0; }
+        };
+
+        // Blobs whose bounding box is not larger than minExtent in both
+        // directions (maxX - minX > minExtent && maxY - minY > minExtent)
+        // are dropped by the labeller.
+        BlobLabeller(int minExtent = 3);
+
+        // mask holds height rows of width bytes, stride bytes apart (width
+        // if 0), non zero for the foreground. The blobs are in the order of
+        // their first pixel, with coordinates relative to mask.
+        const std::vector<Blob>& operator()(const unsigned char* mask, int width, int height,
+                                            std::size_t stride = 0);
+
+        const std::vector<Blob>& blobs() const { return found; }
+        // Components found by the last call, before the size filter.
+        unsigned int nbComponents() const { return nbLabels; }
+
+        int minExtent;
+
+    protected:
+    private:
+        struct Run {
+            int start, end;   // inclusive
+            unsigned int label;
+        };
+
+        struct Sums {
+            double area, x, y, xx, yy, xy;
+            int minX, minY, maxX, maxY;
+        };
+
+        std::vector<Run> previous, current;
+        std::vector<unsigned int> parent;
+        std::vector<Sums> sums;
+        std::vector<Blob> found;
+        unsigned int nbLabels;
+
+        unsigned int newLabel();
+        unsigned int find(unsigned int label);
+        unsigned int merge(unsigned int a, unsigned int b);
+        void scanRow(const unsigned char* row, int width);
+        void add(const Run& run, int y);
+};
+
+#endif // BLOBLABELLER_H
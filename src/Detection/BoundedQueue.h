@@ -0,0 +1,139 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+class BoundedQueueBase
+{
+    public:
+        enum Policy { Block, DropOldest };
+};
+
+// Bounded lock-free ring buffer between two pipeline stages (one producer
+// thread, one consumer thread).
+//
+// When the ring is full, push either waits for the consumer (Block), or
+// discards the oldest queued value (DropOldest), so that a slow consumer
+// always works on the most recent data. Dropping is done by the producer
+// acting as a second consumer, which is why slots are claimed with a
+// compare and swap on the read index (bounded MPMC ring of D. Vyukov,
+// restricted to one producer).
+template<typename T>
+class BoundedQueue : public BoundedQueueBase
+{
+    public:
+        BoundedQueue(unsigned int capacity, Policy policy)
+            :slots(new Slot[capacity]), size(capacity), policy(policy),
+             head(0), tail(0), nbDropped(0), isClosed(false)
+        {
+            for (std::size_t i = 0; i < size; ++i)
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        // Returns false if the queue is closed.
+        bool push(const T& value) {
+            Backoff backoff;
+            while (!tryPush(value)) {
+                if (isClosed.load(std::memory_order_acquire))
+                    return false;
+                T oldest;
+                if (policy == DropOldest && tryPop(oldest))
+                    nbDropped.fetch_add(1, std::memory_order_relaxed);
+                else
+                    backoff();
+            }
+            return true;
+        }
+
+        // Waits for a value. Returns false once the queue is closed and
+        // empty.
+        bool pop(T& value) {
+            Backoff backoff;
+            while (!tryPop(value)) {
+                if (isClosed.load(std::memory_order_acquire))
+                    return tryPop(value);
+                backoff();
+            }
+            return true;
+        }
+
+        bool tryPush(const T& value) {
+            std::size_t pos = head.load(std::memory_order_relaxed);
+            Slot& slot = slots[pos % size];
+            if (slot.sequence.load(std::memory_order_acquire) != pos)
+                return false;
+            slot.value = value;
+            slot.sequence.store(pos + 1, std::memory_order_release);
+            head.store(pos + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        bool tryPop(T& value) {
+            std::size_t pos = tail.load(std::memory_order_relaxed);
+            while (true) {
+                Slot& slot = slots[pos % size];
+                std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)(pos + 1);
+                if (diff == 0) {
+                    if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        value = slot.value;
+                        slot.value = T(); // do not hold frames in the ring
+                        slot.sequence.store(pos + size, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                    return false;
+                else
+                    pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Wakes up both sides : push fails from now on, pop drains what
+        // is left.
+        void close() { isClosed.store(true, std::memory_order_release); }
+        bool closed() const { return isClosed.load(std::memory_order_acquire); }
+
+        unsigned long dropped() const { return nbDropped.load(std::memory_order_relaxed); }
+        unsigned int capacity() const { return size; }
+
+    private:
+        struct Slot {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        // Stages run at frame rate : spin a little, then sleep.
+        struct Backoff {
+            unsigned int spins;
+            Backoff() : spins(0) {}
+            void operator()() {
+                if (++spins < 64)
+                    std::this_thread::yield();
+                else
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+        };
+
+        BoundedQueue(const BoundedQueue&);
+        BoundedQueue& operator=(const BoundedQueue&);
+
+        std::unique_ptr<Slot[]> slots;
+        const std::size_t size;
+        const Policy policy;
+
+        // Producer and consumer indices on separate cache lines.
+        char pad0[64];
+        std::atomic<std::size_t> head;
+        char pad1[64];
+        std::atomic<std::size_t> tail;
+        char pad2[64];
+        std::atomic<unsigned long> nbDropped;
+        std::atomic<bool> isClosed;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,98 @@
+#include <math.h>
+#include <fstream>
+#include <sstream>
+#include <glog/logging.h>
+#include "Calibration.h"
+
+std::string Calibration::directory = "calibration";
+
+double Calibration::standardFov(double zoom) {
+    return 4.189301e+001 - 6.436043e-003*zoom + 2.404497e-007*zoom*zoom;
+}
+
+Calibration::Calibration()
+    :ratios(MaxZoom - MinZoom + 1), file()
+{
+    for (std::size_t i = 0; i < ratios.size(); ++i)
+        ratios[i] = 1/tan((M_PI*standardFov(MinZoom + i)/180.0)/2);
+}
+
+Calibration::Calibration(const std::vector<std::pair<double, double> >& fovs, const std::string& file)
+    :ratios(MaxZoom - MinZoom + 1), file(file)
+{
+    std::size_t next = 0;
+    for (std::size_t i = 0; i < ratios.size(); ++i) {
+        double zoom = MinZoom + i;
+        while (next < fovs.size() && fovs[next].first < zoom)
+            ++next;
+
+        double fov;
+        if (next == 0)
+            fov = fovs.front().second;
+        else if (next == fovs.size())
+            fov = fovs.back().second;
+        else {
+            const std::pair<double, double>& a = fovs[next - 1];
+            const std::pair<double, double>& b = fovs[next];
+            fov = a.second + (zoom - a.first) * (b.second - a.second) / (b.first - a.first);
+        }
+        ratios[i] = 1/tan((M_PI*fov/180.0)/2);
+    }
+}
+
+bool Calibration::read(const std::string& path, std::vector<std::pair<double, double> >& fovs) {
+    std::ifstream in(path.c_str());
+    if (!in)
+        return false;
+
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        ++number;
+        std::string::size_type comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+        std::istringstream fields(line);
+        double zoom, fov;
+        if (!(fields >> zoom))
+            continue; // blank line
+        std::string rest;
+        if (!(fields >> fov) || fields >> rest
+            || fov <= 0 || fov >= 180
+            || (!fovs.empty() && zoom <= fovs.back().first)) {
+            LOG(ERROR) << path << ':' << number << ": expected increasing \"<zoom> <fov>\"";
+            return false;
+        }
+        fovs.push_back(std::make_pair(zoom, fov));
+    }
+    if (fovs.empty()) {
+        LOG(ERROR) << path << ": no calibration point";
+        return false;
+    }
+    return true;
+}
+
+Calibration::Ptr Calibration::load(const std::string& host, int port) {
+    std::ostringstream withPort;
+    withPort << directory << '/' << host << '_' << port << ".calib";
+    std::string paths[2] = { withPort.str(), directory + '/' + host + ".calib" };
+
+    for (int i = 0; i < 2; ++i) {
+        std::ifstream exists(paths[i].c_str());
+        if (!exists)
+            continue;
+        std::vector<std::pair<double, double> > fovs;
+        if (read(paths[i], fovs)) {
+            LOG(INFO) << "Calibration of " << host << ':' << port << ": " << paths[i];
+            return Ptr(new Calibration(fovs, paths[i]));
+        }
+        break;
+    }
+    LOG(INFO) << "Calibration of " << host << ':' << port << ": standard";
+    return standard();
+}
+
+Calibration::Ptr Calibration::standard() {
+    static Ptr model(new Calibration());
+    return model;
+}
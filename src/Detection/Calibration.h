@@ -0,0 +1,73 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Zoom -> focal length model of one camera, tabulated once for every
+// zoom step of the Axis cameras (1 to 9999), so that looking up a focal
+// length is a linear interpolation between two entries.
+//
+// A camera is calibrated by a text file named after its host, in
+// Calibration::directory :
+//     <host>_<port>.calib   (tried first)
+//     <host>.calib
+// holding one "<zoom> <horizontal field of view (degrees)>" pair per
+// line, in increasing zoom order ('#' starts a comment). The field of
+// view is interpolated linearly between the pairs, and kept constant
+// beyond the first and last ones.
+//
+// Without a file, the model is the polynomial fitted on the first camera,
+// which all the cameras used to share.
+class Calibration
+{
+    public:
+        typedef std::shared_ptr<const Calibration> Ptr;
+
+        static const int MinZoom = 1;
+        static const int MaxZoom = 9999;
+
+        // "calibration" by default.
+        static std::string directory;
+
+        // Falls back on standard() when there is no valid file.
+        static Ptr load(const std::string& host, int port);
+        static Ptr standard();
+
+        // Focal length in pixels, for an image whose center is at u0.
+        double focal(double zoom, double u0) const {
+            double position = zoom - MinZoom;
+            if (position < 0)
+                position = 0;
+            std::size_t i = (std::size_t)position;
+            if (i > ratios.size() - 2)
+                i = ratios.size() - 2;
+            double t = position - i;
+            if (t > 1)
+                t = 1;
+            return u0 * (ratios[i] + t * (ratios[i + 1] - ratios[i]));
+        }
+
+        // File the model was read from, empty for standard().
+        const std::string& source() const { return file; }
+
+        // Field of view (degrees) of the standard model.
+        static double standardFov(double zoom);
+
+    protected:
+    private:
+        // (zoom, field of view) pairs, sorted by zoom.
+        Calibration(const std::vector<std::pair<double, double> >& fovs, const std::string& file);
+        Calibration();
+
+        // focal / u0 = 1 / tan(fov / 2), for zoom = MinZoom + i.
+        std::vector<double> ratios;
+        std::string file;
+
+        static bool read(const std::string& path, std::vector<std::pair<double, double> >& fovs);
+};
+
+#endif // CALIBRATION_H
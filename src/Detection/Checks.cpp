@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glog/logging.h>
+#include "BlobLabeller.h"
+#include "LatencyHistogram.h"
+#include "TargetTracker.h"
+#include "../Position/PositionServer/shared-value.h"
+
+// Checks of the optimized parts of the detection against straightforward
+// versions of them, on random inputs :
+//     checks [-n <iterations>] [-s <seed>]
+// BlobLabeller against a flood fill, the assignment of TargetTracker
+// against all the permutations, the buckets of LatencyHistogram against
+// their precision, and the gets of the position server chained by their
+// end time against the points put. Each failure is logged, and the exit
+// status is the number of checks which failed.
+
+void loggerInit(char* argv0) {
+    google::InitGoogleLogging(argv0);
+    FLAGS_logtostderr = 1;
+}
+
+namespace {
+
+std::mt19937 generator;
+
+int uniform(int lo, int hi) {
+    return std::uniform_int_distribution<int>(lo, hi)(generator);
+}
+
+// Moments of a component, summed in the order of its pixels.
+struct Component {
+    unsigned int area;
+    int minX, minY, maxX, maxY;
+    double x, y, xx, yy, xy;
+};
+
+// 8 neighbors components of mask, in the order of their first pixel,
+// filtered as BlobLabeller does.
+std::vector<Component> floodFill(const std::vector<unsigned char>& mask, int width, int height,
+                                 int minExtent) {
+    std::vector<char> seen(mask.size(), 0);
+    std::vector<Component> found;
+    std::vector<int> stack;
+    for (int i = 0; i < width * height; ++i) {
+        if (!mask[i] || seen[i])
+            continue;
+        Component c = { 0, width, height, -1, -1, 0, 0, 0, 0, 0 };
+        seen[i] = 1;
+        stack.assign(1, i);
+        while (!stack.empty()) {
+            int k = stack.back(), x = k % width, y = k / width;
+            stack.pop_back();
+            ++c.area;
+            c.minX = std::min(c.minX, x);
+            c.minY = std::min(c.minY, y);
+            c.maxX = std::max(c.maxX, x);
+            c.maxY = std::max(c.maxY, y);
+            c.x += x;
+            c.y += y;
+            c.xx += (double)x * x;
+            c.yy += (double)y * y;
+            c.xy += (double)x * y;
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int nx = x + dx, ny = y + dy;
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                        continue;
+                    int n = ny * width + nx;
+                    if (mask[n] && !seen[n]) {
+                        seen[n] = 1;
+                        stack.push_back(n);
+                    }
+                }
+        }
+        if (c.maxX - c.minX > minExtent && c.maxY - c.minY > minExtent)
+            found.push_back(c);
+    }
+    return found;
+}
+
+bool close(double a, double b) {
+    return std::fabs(a - b) <= 1e-6 * std::max(1.0, std::fabs(b));
+}
+
+// Random masks of random sizes and densities, with filled rectangles so
+// that some components pass the size filter.
+bool checkBlobLabeller(int iterations) {
+    BlobLabeller labeller;
+    std::vector<unsigned char> mask;
+    for (int it = 0; it < iterations; ++it) {
+        int width = uniform(1, 120), height = uniform(1, 90);
+        int density = uniform(0, 100);
+        mask.resize(width * height);
+        for (std::size_t i = 0; i < mask.size(); ++i)
+            mask[i] = uniform(0, 99) < density ? 255 : 0;
+        for (int k = uniform(0, 6); k > 0; --k) {
+            int x0 = uniform(0, width - 1), y0 = uniform(0, height - 1);
+            int x1 = std::min(width, x0 + uniform(0, 25)), y1 = std::min(height, y0 + uniform(0, 25));
+            for (int y = y0; y < y1; ++y)
+                std::fill(mask.begin() + y * width + x0, mask.begin() + y * width + x1, 1);
+        }
+
+        std::vector<Component> expected = floodFill(mask, width, height, labeller.minExtent);
+        const std::vector<BlobLabeller::Blob>& blobs = labeller(mask.data(), width, height);
+        if (blobs.size() != expected.size()) {
+            LOG(ERROR) << "Error : BlobLabeller found " << blobs.size() << " blobs instead of "
+                       << expected.size() << " in a " << width << "x" << height << " mask";
+            return false;
+        }
+        for (std::size_t i = 0; i < blobs.size(); ++i) {
+            const BlobLabeller::Blob& b = blobs[i];
+            const Component& c = expected[i];
+            double cx = c.x / c.area, cy = c.y / c.area;
+            if (b.area != c.area || b.minX != c.minX || b.minY != c.minY
+                || b.maxX != c.maxX || b.maxY != c.maxY
+                || !close(b.cx, cx) || !close(b.cy, cy)
+                || !close(b.mxx, c.xx / c.area - cx * cx) || !close(b.myy, c.yy / c.area - cy * cy)
+                || !close(b.mxy, c.xy / c.area - cx * cy)) {
+                LOG(ERROR) << "Error : BlobLabeller blob " << i << " differs from the flood fill in a "
+                           << width << "x" << height << " mask";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Random costs, some of them forbidding the pair as in TargetTracker,
+// against the cheapest of all the assignments.
+bool checkAssignment(int iterations) {
+    std::vector<double> costs;
+    std::vector<int> assigned, columns;
+    for (int it = 0; it < iterations; ++it) {
+        int nbRows = uniform(1, 5), nbCols = nbRows + uniform(0, 2);
+        costs.resize(nbRows * nbCols);
+        for (std::size_t i = 0; i < costs.size(); ++i)
+            costs[i] = uniform(0, 3) == 0 ? 1e9 : uniform(0, 1000) / 10.0;
+
+        TargetTracker::assign(costs, nbRows, nbCols, assigned);
+        double cost = 0;
+        std::vector<char> taken(nbCols, 0);
+        for (int row = 0; row < nbRows; ++row) {
+            int col = assigned[row];
+            if (col < 0 || col >= nbCols || taken[col]) {
+                LOG(ERROR) << "Error : invalid assignment of " << nbRows << "x" << nbCols << " costs";
+                return false;
+            }
+            taken[col] = 1;
+            cost += costs[row * nbCols + col];
+        }
+
+        columns.resize(nbCols);
+        for (int col = 0; col < nbCols; ++col)
+            columns[col] = col;
+        double best = HUGE_VAL;
+        do {
+            double sum = 0;
+            for (int row = 0; row < nbRows; ++row)
+                sum += costs[row * nbCols + columns[row]];
+            best = std::min(best, sum);
+        } while (std::next_permutation(columns.begin(), columns.end()));
+        if (!close(cost, best)) {
+            LOG(ERROR) << "Error : assignment of " << nbRows << "x" << nbCols << " costs costs "
+                       << cost << " instead of " << best;
+            return false;
+        }
+    }
+    return true;
+}
+
+// The value a duration is reported as, alone below a larger one so that
+// the maximum does not clip it.
+uint64_t reported(LatencyHistogram& histogram, uint64_t nanoseconds) {
+    histogram.reset();
+    histogram.record(nanoseconds);
+    histogram.record(~(uint64_t)0);
+    return histogram.percentile(0.5);
+}
+
+// Durations below 32 ns are exact, the others within 1/64 (half a bucket),
+// and the reported values never decrease with the durations. Around each
+// power of two, and at random.
+bool checkLatencyHistogram(int iterations) {
+    LatencyHistogram histogram;
+    std::vector<uint64_t> durations;
+    for (uint64_t d = 0; d < 64; ++d)
+        durations.push_back(d);
+    for (int shift = 6; shift < 41; ++shift)
+        for (int delta = -2; delta <= 2; ++delta)
+            durations.push_back(((uint64_t)1 << shift) + delta);
+    for (int it = 0; it < iterations; ++it)
+        durations.push_back(std::uniform_int_distribution<uint64_t>(0, (uint64_t)1 << 41)(generator));
+    std::sort(durations.begin(), durations.end());
+
+    uint64_t previous = 0;
+    for (std::size_t i = 0; i < durations.size(); ++i) {
+        uint64_t d = durations[i], value = reported(histogram, d);
+        uint64_t error = value > d ? value - d : d - value;
+        if ((d < 32 && error != 0) || error > d / 64 || value < previous) {
+            LOG(ERROR) << "Error : LatencyHistogram reports " << d << " ns as " << value << " ns";
+            return false;
+        }
+        previous = value;
+    }
+
+    // Longer durations are counted in the last bucket, reported about
+    // 2^41 ns, and the maximum stays exact.
+    histogram.reset();
+    histogram.record((uint64_t)1 << 50);
+    uint64_t last = histogram.percentile(1);
+    if (histogram.count() != 1 || histogram.max() != (uint64_t)1 << 50
+        || last < (uint64_t)1 << 40 || last > (uint64_t)1 << 41) {
+        LOG(ERROR) << "Error : LatencyHistogram loses the durations above its range";
+        return false;
+    }
+
+    histogram.reset();
+    for (uint64_t d = 1; d <= 1000; ++d)
+        histogram.record(d * 1000);
+    uint64_t p50 = histogram.percentile(0.5), p99 = histogram.percentile(0.99);
+    if (histogram.count() != 1000 || p50 < 500000 - 500000 / 64 || p50 > 500000 + 500000 / 64
+        || p99 < 990000 - 990000 / 64 || p99 > 990000 + 990000 / 64) {
+        LOG(ERROR) << "Error : LatencyHistogram percentiles of 1 to 1000 us : p50 " << p50 << " p99 " << p99;
+        return false;
+    }
+    return true;
+}
+
+// Points put one by one and in batches, several in the same microsecond
+// and across chunks, while gets chained as a client of the position
+// server does ("get since <end of the previous get>", in microseconds)
+// must return each of them once, in order.
+bool checkChainedGets(int iterations) {
+    std::vector<int> sizes(iterations);
+    std::size_t total = 0;
+    for (int i = 0; i < iterations; ++i) {
+        sizes[i] = uniform(0, 1) ? 1 : uniform(1, 2 * SharedValue::ChunkSize);
+        total += sizes[i];
+    }
+    SharedValue value;
+    value.setCapacity(total);
+
+    std::thread writer([&] {
+        std::vector<Data> batch;
+        int label = 0;
+        for (int i = 0; i < iterations; ++i) {
+            batch.clear();
+            for (int k = 0; k < sizes[i]; ++k)
+                batch.push_back(Data(label++, Point(0, 0)));
+            value.put(batch.data(), batch.size());
+        }
+    });
+
+    std::vector<int> labels;
+    Time since;
+    bool done = false;
+    while (!done) {
+        done = labels.size() >= total;
+        SharedValue::Snapshot points = value(since);
+        for (std::size_t i = 0; i < points.size(); ++i)
+            labels.push_back(points[i].data.first);
+        if (points.size() > 0)
+            since = Time(std::chrono::duration_cast<std::chrono::microseconds>(
+                             points[points.size() - 1].time.time_since_epoch()));
+        if (labels.size() > total)
+            break;
+    }
+    writer.join();
+
+    for (std::size_t i = 0; i < labels.size(); ++i)
+        if (labels[i] != (int)i) {
+            LOG(ERROR) << "Error : chained gets return point " << labels[i] << " instead of " << i;
+            return false;
+        }
+    if (labels.size() != total || value.lost() != 0) {
+        LOG(ERROR) << "Error : chained gets return " << labels.size() << " points of " << total;
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    loggerInit(argv[0]);
+    int iterations = 1000;
+    unsigned int seed = 1;
+    while (argc > 2 && argv[1][0] == '-') {
+        std::string option(argv[1]);
+        if (option == "-n")
+            iterations = atoi(argv[2]);
+        else if (option == "-s")
+            seed = atoi(argv[2]);
+        else
+            break;
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc > 1) {
+        std::cerr << "Usage : checks [-n <iterations>] [-s <seed>]" << std::endl;
+        return 1;
+    }
+    generator.seed(seed);
+
+    struct Check {
+        const char* name;
+        bool (*run)(int iterations);
+    } checks[] = {
+        { "BlobLabeller", checkBlobLabeller },
+        { "TargetTracker::assign", checkAssignment },
+        { "LatencyHistogram", checkLatencyHistogram },
+        { "SharedValue gets", checkChainedGets }
+    };
+    int failed = 0;
+    for (std::size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i) {
+        bool passed = checks[i].run(iterations);
+        std::cout << checks[i].name << " : " << (passed ? "ok" : "FAILED") << std::endl;
+        if (!passed)
+            ++failed;
+    }
+    return failed;
+}
@@ -0,0 +1,288 @@
+#include "ColorFilter.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COLORFILTER_X86
+#endif
+
+namespace {
+
+typedef void (*Kernel)(const unsigned char*, unsigned char*, unsigned char*,
+                       std::size_t, int);
+
+struct Implementation {
+    Kernel withMask;
+    Kernel swapOnly;
+    const char* name;
+};
+
+// mask and swapped are optional, at least one of them is set.
+template<bool MASK, bool SWAP>
+void kernelScalar(const unsigned char* src, unsigned char* mask,
+                  unsigned char* swapped, std::size_t nbPixels, int threshold) {
+    for (std::size_t i = 0; i < nbPixels; ++i, src += 3) {
+        unsigned char r = src[0], g = src[1], b = src[2];
+        if (MASK) {
+            unsigned char hi = r > b ? r : b;
+            unsigned char lo = r > b ? b : r;
+            mask[i] = (g > hi && g - lo > threshold) ? 255 : 0;
+        }
+        if (SWAP) {
+            swapped[3*i]     = b;
+            swapped[3*i + 1] = g;
+            swapped[3*i + 2] = r;
+        }
+    }
+}
+
+#ifdef COLORFILTER_X86
+
+// The SIMD kernels work on blocks of 16 pixels (48 bytes, 3 vectors).
+// Byte p of a block is a red byte when p%3 == 0, green when p%3 == 1
+// and blue when p%3 == 2.
+
+// Threshold as seen by the saturated byte arithmetic. For a negative
+// threshold the green > max(red, blue) test is the only one that matters.
+inline unsigned char byteThreshold(int threshold) {
+    return threshold < 0 ? 0 : (threshold > 255 ? 255 : threshold);
+}
+
+struct SwapMasks {
+    // [vector][0: keep, 1: take p+2, 2: take p-2]
+    unsigned char select[3][3][16];
+    // pshufb indices gathering one channel of a block : [channel][vector]
+    unsigned char gather[3][3][16];
+
+    SwapMasks() {
+        for (int k = 0; k < 3; ++k)
+            for (int j = 0; j < 16; ++j) {
+                int p = 16*k + j;
+                select[k][0][j] = p % 3 == 1 ? 0xff : 0;
+                select[k][1][j] = p % 3 == 0 ? 0xff : 0;
+                select[k][2][j] = p % 3 == 2 ? 0xff : 0;
+                for (int c = 0; c < 3; ++c) {
+                    int idx = 3*j + c - 16*k;
+                    gather[c][k][j] = (idx >= 0 && idx < 16) ? idx : 0x80;
+                }
+            }
+    }
+};
+
+const SwapMasks& swapMasks() {
+    static const SwapMasks masks;
+    return masks;
+}
+
+inline __m128i load128(const unsigned char* p) {
+    return _mm_loadu_si128((const __m128i*)p);
+}
+
+// SSE2 has no byte shuffle, channels are split with the unpack network.
+inline void deinterleaveSSE2(__m128i v0, __m128i v1, __m128i v2,
+                             __m128i& r, __m128i& g, __m128i& b) {
+    __m128i t10 = _mm_unpacklo_epi8(v0, _mm_unpackhi_epi64(v1, v1));
+    __m128i t11 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(v0, v0), v2);
+    __m128i t12 = _mm_unpacklo_epi8(v1, _mm_unpackhi_epi64(v2, v2));
+
+    __m128i t20 = _mm_unpacklo_epi8(t10, _mm_unpackhi_epi64(t11, t11));
+    __m128i t21 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t10, t10), t12);
+    __m128i t22 = _mm_unpacklo_epi8(t11, _mm_unpackhi_epi64(t12, t12));
+
+    __m128i t30 = _mm_unpacklo_epi8(t20, _mm_unpackhi_epi64(t21, t21));
+    __m128i t31 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t20, t20), t22);
+    __m128i t32 = _mm_unpacklo_epi8(t21, _mm_unpackhi_epi64(t22, t22));
+
+    r = _mm_unpacklo_epi8(t30, _mm_unpackhi_epi64(t31, t31));
+    g = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t30, t30), t32);
+    b = _mm_unpacklo_epi8(t31, _mm_unpackhi_epi64(t32, t32));
+}
+
+template<bool MASK, bool SWAP>
+void kernelSSE2(const unsigned char* src, unsigned char* mask,
+                unsigned char* swapped, std::size_t nbPixels, int threshold) {
+    const SwapMasks& m = swapMasks();
+    __m128i keep[3], plus[3], minus[3];
+    for (int k = 0; k < 3; ++k) {
+        keep[k]  = load128(m.select[k][0]);
+        plus[k]  = load128(m.select[k][1]);
+        minus[k] = load128(m.select[k][2]);
+    }
+    const __m128i t    = _mm_set1_epi8((char)byteThreshold(threshold));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_cmpeq_epi8(zero, zero);
+
+    std::size_t i = 0;
+    for (; i + 16 <= nbPixels; i += 16, src += 48) {
+        __m128i v0 = load128(src);
+        __m128i v1 = load128(src + 16);
+        __m128i v2 = load128(src + 32);
+
+        if (MASK) {
+            __m128i r, g, b;
+            deinterleaveSSE2(v0, v1, v2, r, g, b);
+            // g > max(hi, lo + t)  <=>  g -sat max(...) != 0
+            __m128i bound = _mm_max_epu8(_mm_max_epu8(r, b),
+                                         _mm_adds_epu8(_mm_min_epu8(r, b), t));
+            __m128i fail  = _mm_cmpeq_epi8(_mm_subs_epu8(g, bound), zero);
+            _mm_storeu_si128((__m128i*)(mask + i), _mm_xor_si128(fail, ones));
+        }
+        if (SWAP) {
+            __m128i p0 = _mm_or_si128(_mm_srli_si128(v0, 2), _mm_slli_si128(v1, 14));
+            __m128i p1 = _mm_or_si128(_mm_srli_si128(v1, 2), _mm_slli_si128(v2, 14));
+            __m128i p2 = _mm_srli_si128(v2, 2);
+            __m128i m0 = _mm_slli_si128(v0, 2);
+            __m128i m1 = _mm_or_si128(_mm_slli_si128(v1, 2), _mm_srli_si128(v0, 14));
+            __m128i m2 = _mm_or_si128(_mm_slli_si128(v2, 2), _mm_srli_si128(v1, 14));
+            unsigned char* dst = swapped + 3*i;
+            _mm_storeu_si128((__m128i*)dst,
+                _mm_or_si128(_mm_or_si128(_mm_and_si128(v0, keep[0]), _mm_and_si128(p0, plus[0])),
+                             _mm_and_si128(m0, minus[0])));
+            _mm_storeu_si128((__m128i*)(dst + 16),
+                _mm_or_si128(_mm_or_si128(_mm_and_si128(v1, keep[1]), _mm_and_si128(p1, plus[1])),
+                             _mm_and_si128(m1, minus[1])));
+            _mm_storeu_si128((__m128i*)(dst + 32),
+                _mm_or_si128(_mm_or_si128(_mm_and_si128(v2, keep[2]), _mm_and_si128(p2, plus[2])),
+                             _mm_and_si128(m2, minus[2])));
+        }
+    }
+    kernelScalar<MASK, SWAP>(src, mask + (MASK ? i : 0),
+                             SWAP ? swapped + 3*i : swapped,
+                             nbPixels - i, threshold);
+}
+
+// AVX2 byte shuffles do not cross 128 bits lanes, so each lane handles its
+// own block : 32 pixels per iteration.
+__attribute__((target("avx2")))
+inline __m256i loadBlocks(const unsigned char* p) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(load128(p)),
+                                   load128(p + 48), 1);
+}
+
+__attribute__((target("avx2")))
+inline __m256i broadcast128(const unsigned char* p) {
+    return _mm256_broadcastsi128_si256(load128(p));
+}
+
+__attribute__((target("avx2")))
+inline void storeBlocks(unsigned char* p, __m256i v) {
+    _mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(v));
+    _mm_storeu_si128((__m128i*)(p + 48), _mm256_extracti128_si256(v, 1));
+}
+
+__attribute__((target("avx2")))
+inline __m256i gather(const SwapMasks& m, int c, __m256i v0, __m256i v1, __m256i v2) {
+    return _mm256_or_si256(
+        _mm256_or_si256(_mm256_shuffle_epi8(v0, broadcast128(m.gather[c][0])),
+                        _mm256_shuffle_epi8(v1, broadcast128(m.gather[c][1]))),
+        _mm256_shuffle_epi8(v2, broadcast128(m.gather[c][2])));
+}
+
+template<bool MASK, bool SWAP>
+__attribute__((target("avx2")))
+void kernelAVX2(const unsigned char* src, unsigned char* mask,
+                unsigned char* swapped, std::size_t nbPixels, int threshold) {
+    const SwapMasks& m = swapMasks();
+    __m256i keep[3], plus[3], minus[3];
+    for (int k = 0; k < 3; ++k) {
+        keep[k]  = broadcast128(m.select[k][0]);
+        plus[k]  = broadcast128(m.select[k][1]);
+        minus[k] = broadcast128(m.select[k][2]);
+    }
+    const __m256i t    = _mm256_set1_epi8((char)byteThreshold(threshold));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_cmpeq_epi8(zero, zero);
+
+    std::size_t i = 0;
+    for (; i + 32 <= nbPixels; i += 32, src += 96) {
+        __m256i v0 = loadBlocks(src);
+        __m256i v1 = loadBlocks(src + 16);
+        __m256i v2 = loadBlocks(src + 32);
+
+        if (MASK) {
+            __m256i r = gather(m, 0, v0, v1, v2);
+            __m256i g = gather(m, 1, v0, v1, v2);
+            __m256i b = gather(m, 2, v0, v1, v2);
+            __m256i bound = _mm256_max_epu8(_mm256_max_epu8(r, b),
+                                            _mm256_adds_epu8(_mm256_min_epu8(r, b), t));
+            __m256i fail  = _mm256_cmpeq_epi8(_mm256_subs_epu8(g, bound), zero);
+            _mm256_storeu_si256((__m256i*)(mask + i), _mm256_xor_si256(fail, ones));
+        }
+        if (SWAP) {
+            __m256i p0 = _mm256_alignr_epi8(v1, v0, 2);
+            __m256i p1 = _mm256_alignr_epi8(v2, v1, 2);
+            __m256i p2 = _mm256_srli_si256(v2, 2);
+            __m256i m0 = _mm256_slli_si256(v0, 2);
+            __m256i m1 = _mm256_alignr_epi8(v1, v0, 14);
+            __m256i m2 = _mm256_alignr_epi8(v2, v1, 14);
+            unsigned char* dst = swapped + 3*i;
+            storeBlocks(dst,
+                _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(v0, keep[0]), _mm256_and_si256(p0, plus[0])),
+                                _mm256_and_si256(m0, minus[0])));
+            storeBlocks(dst + 16,
+                _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(v1, keep[1]), _mm256_and_si256(p1, plus[1])),
+                                _mm256_and_si256(m1, minus[1])));
+            storeBlocks(dst + 32,
+                _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(v2, keep[2]), _mm256_and_si256(p2, plus[2])),
+                                _mm256_and_si256(m2, minus[2])));
+        }
+    }
+    kernelSSE2<MASK, SWAP>(src, mask + (MASK ? i : 0),
+                           SWAP ? swapped + 3*i : swapped,
+                           nbPixels - i, threshold);
+}
+
+#endif // COLORFILTER_X86
+
+// A kernel with a null swapped pointer must not write the swapped
+// pixels, hence the two entry points per implementation.
+template<Kernel MASK_ONLY, Kernel MASK_SWAP>
+void withMask(const unsigned char* src, unsigned char* mask,
+              unsigned char* swapped, std::size_t nbPixels, int threshold) {
+    if (swapped)
+        MASK_SWAP(src, mask, swapped, nbPixels, threshold);
+    else
+        MASK_ONLY(src, mask, swapped, nbPixels, threshold);
+}
+
+Implementation select() {
+#ifdef COLORFILTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        Implementation impl = {
+            withMask<kernelAVX2<true, false>, kernelAVX2<true, true> >,
+            kernelAVX2<false, true>, "avx2" };
+        return impl;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        Implementation impl = {
+            withMask<kernelSSE2<true, false>, kernelSSE2<true, true> >,
+            kernelSSE2<false, true>, "sse2" };
+        return impl;
+    }
+#endif
+    Implementation impl = {
+        withMask<kernelScalar<true, false>, kernelScalar<true, true> >,
+        kernelScalar<false, true>, "scalar" };
+    return impl;
+}
+
+const Implementation& selected() {
+    static const Implementation impl = select();
+    return impl;
+}
+
+}
+
+void ColorFilter::greenMask(const unsigned char* src, unsigned char* mask,
+                            unsigned char* swapped, std::size_t nbPixels,
+                            int threshold) {
+    selected().withMask(src, mask, swapped, nbPixels, threshold);
+}
+
+void ColorFilter::swapRedBlue(unsigned char* buf, std::size_t nbPixels) {
+    selected().swapOnly(buf, 0, buf, nbPixels, 0);
+}
+
+const char* ColorFilter::implementation() {
+    return selected().name;
+}
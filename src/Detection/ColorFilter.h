@@ -0,0 +1,32 @@
+#ifndef COLORFILTER_H
+#define COLORFILTER_H
+
+#include <cstddef>
+
+// Single pass green threshold over packed 24 bits pixels.
+//
+// A pixel is kept (mask value 255) when
+//     green > red && green > blue && green - min(red, blue) > threshold
+// which is the test FrameProcessor used to apply pixel by pixel on the
+// mirage image. The test is symmetric in red and blue, so it gives the
+// same mask on RGB and BGR buffers.
+//
+// The implementation (AVX2, SSE2 or scalar) is picked once at runtime
+// from the cpu features.
+namespace ColorFilter {
+
+    // Writes one byte per pixel in mask. If swapped is not null, the
+    // red/blue swapped pixels are also written there, in the same pass
+    // (swapped may be equal to src for an in place conversion).
+    void greenMask(const unsigned char* src, unsigned char* mask,
+                   unsigned char* swapped, std::size_t nbPixels,
+                   int threshold);
+
+    // In place red/blue swap (BGR <-> RGB).
+    void swapRedBlue(unsigned char* buf, std::size_t nbPixels);
+
+    // Name of the selected implementation ("avx2", "sse2" or "scalar").
+    const char* implementation();
+}
+
+#endif // COLORFILTER_H
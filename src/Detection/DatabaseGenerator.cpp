@@ -1,39 +1,192 @@
 #include <string>
-#include <fstream>
-#include <boost/filesystem.hpp>
-#include <boost/foreach.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 #include <glog/logging.h>
-#include "FrameCapturer.h"
+#include "FrameArchive.h"
 #include "FrameProcessor.h"
+#include "ReplaySource.h"
+#include "WorkerPool.h"
+#include "TraceLog.h"
 
-using namespace std;
-using namespace boost::filesystem;
+// Builds an archive (see FrameArchive) of the frames of the directories
+// given on the command line, named after their pose (see PoseFilename.h) :
+// each frame is decoded, the targets are searched in it with the threshold
+// given, and its pixels are stored, LZ4 compressed with -z.
+//
+// The frames are decoded by the threads of a ReplaySource, searched and
+// compressed by those of a WorkerPool, and written in the order of the
+// directories, then of their recording (see ReplaySource).
 
 void loggerInit(char* argv0) {
     google::InitGoogleLogging(argv0);
     FLAGS_logtostderr = 1;
     FLAGS_minloglevel = 1;
+    TraceLog::start();
+}
+
+namespace {
+
+// A frame between the decoding and the writing.
+struct Job {
+    FrameBuffer::Ptr frame;
+    ArchiveRecord record;
+    std::vector<unsigned char> stored;
+    std::vector<ArchiveDetection> detections;
+    bool done;
+};
+
 }
 
 int main(int argc, char* argv[]) {
+    char* program = argv[0];
+    bool compress = false;
+    unsigned int scale = 1;
+    unsigned int nbWorkers = 0;
+    while (argc > 1 && argv[1][0] == '-') {
+        std::string option(argv[1]);
+        if (option == "-z")
+            compress = true;
+        else if (option == "-j" && argc > 2) {
+            scale = atoi(argv[2]);
+            --argc;
+            ++argv;
+        }
+        else if (option == "-w" && argc > 2) {
+            nbWorkers = atoi(argv[2]);
+            --argc;
+            ++argv;
+        }
+        else
+            break;
+        --argc;
+        ++argv;
+    }
+    argv[0] = program;
+    if (argc < 4) {
+        std::cerr << "Usage : " << argv[0]
+                  << " [-z] [-j <scale>] [-w <workers>] <threshold> <archive> <directory>..." << std::endl
+                  << "  -z : compress the pixels (LZ4)" << std::endl
+                  << "  -j : store the frames at 1/scale of their size (1, 2, 4 or 8)" << std::endl
+                  << "  -w : search and compression threads (0, default : one per core)" << std::endl
+                  << "ex : " << argv[0] << " 35 playground.archive PlayGround" << std::endl;
+        return 1;
+    }
     loggerInit(argv[0]);
 
-    string filename("data");
-    path dataFilePath(filename);
-    if (exists(dataFilePath))
-        remove(filename);
-
-    ofstream dataFile(filename);
-    path dir(".");
-    directory_iterator it(dir), eod;
-    if(is_directory(dir)) {
-        BOOST_FOREACH(path const &p, std::make_pair(it, eod)) {
-            std::cout << p.filename().string() << std::endl;
-            dataFile << p.filename().string() << endl;
-        }
+    int threshold = atoi(argv[1]);
+    FrameArchiveWriter writer(argv[2], compress, threshold);
+    if (!writer.isOpen())
+        return 1;
+
+    WorkerPool workers(nbWorkers);
+    // Enough frames in flight to keep the workers busy while the oldest
+    // one is written, each with a processor of its own.
+    std::size_t window = 2 * workers.size();
+    std::vector<std::unique_ptr<FrameProcessor> > processors;
+    std::vector<FrameProcessor*> idle;
+    for (std::size_t i = 0; i < window; ++i) {
+        processors.push_back(std::unique_ptr<FrameProcessor>(new FrameProcessor()));
+        idle.push_back(processors.back().get());
     }
 
-    dataFile.close();
+    std::mutex lock;
+    std::condition_variable finished;
+    std::deque<std::shared_ptr<Job> > inFlight;
+    bool failed = false;
+    unsigned long nbFrames = 0, nbTargets = 0;
+
+    // Writes the jobs done, in order, until at most limit are in flight.
+    auto write = [&](std::size_t limit) {
+        std::unique_lock<std::mutex> exclusion(lock);
+        while (!inFlight.empty()) {
+            std::shared_ptr<Job> job = inFlight.front();
+            if (!job->done) {
+                if (inFlight.size() <= limit)
+                    return;
+                finished.wait(exclusion);
+                continue;
+            }
+            inFlight.pop_front();
+            exclusion.unlock();
+            if (!writer.add(job->record, job->stored, job->detections))
+                failed = true;
+            ++nbFrames;
+            nbTargets += job->detections.size();
+            exclusion.lock();
+        }
+    };
+
+    double start = FrameBuffer::now();
+    for (int d = 3; d < argc && !failed; ++d) {
+        ReplaySource source(argv[d], 0, 8, scale);
+        while (FrameBuffer::Ptr frame = source.next()) {
+            std::shared_ptr<Job> job(new Job());
+            job->frame = frame;
+            job->done = false;
+            ArchiveRecord& record = job->record;
+            std::memset(&record, 0, sizeof(record));
+            const FramePose& pose = source.pose(frame->sequence);
+            record.pan = pose.pan;
+            record.tilt = pose.tilt;
+            record.zoom = pose.zoom;
+            record.x = pose.x;
+            record.y = pose.y;
+            record.time = frame->time;
+            record.width = frame->image._dimension[0];
+            record.height = frame->image._dimension[1];
+            const std::string& path = source.path(frame->sequence);
+            std::string::size_type slash = path.find_last_of('/');
+            std::strncpy(record.name, path.c_str() + (slash == std::string::npos ? 0 : slash + 1),
+                         sizeof(record.name) - 1);
+
+            write(window - 1);
+            {
+                std::unique_lock<std::mutex> exclusion(lock);
+                inFlight.push_back(job);
+            }
+            workers.submit([&, job]() {
+                FrameProcessor* processor;
+                {
+                    std::unique_lock<std::mutex> exclusion(lock);
+                    processor = idle.back();
+                    idle.pop_back();
+                }
+                processor->setFrame(job->frame);
+                processor->filterColor(threshold);
+                std::vector<PanTiltCentered> found = processor->findPositions();
+                for (std::size_t i = 0; i < found.size(); ++i) {
+                    ArchiveDetection detection;
+                    detection.pan = found[i].first;
+                    detection.tilt = found[i].second;
+                    job->detections.push_back(detection);
+                }
+                FrameArchiveWriter::pack(imageBytes(job->frame->image),
+                                         3 * (std::size_t)job->record.width * job->record.height,
+                                         writer.compressed(), job->stored);
+                job->frame.reset();
+
+                std::unique_lock<std::mutex> exclusion(lock);
+                idle.push_back(processor);
+                job->done = true;
+                finished.notify_all();
+            });
+        }
+        write(0);
+    }
+    write(0);
+    uint64_t bytes = writer.written();
+    if (!writer.close() || failed)
+        return 1;
 
+    std::cerr << "frames: " << nbFrames
+              << " targets: " << nbTargets
+              << " bytes: " << bytes
+              << " seconds: " << FrameBuffer::now() - start << std::endl;
     return 0;
 }
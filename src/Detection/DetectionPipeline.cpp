@@ -0,0 +1,136 @@
+#include <glog/logging.h>
+#include "FrameCapturer.h"
+#include "DetectionPipeline.h"
+
+DetectionPipeline::DetectionPipeline(FrameCapturer& fc, int threshold, Publisher publisher,
+                                     unsigned int depth, Policy policy)
+    :source(std::bind(&FrameCapturer::grabFrame, &fc)), publisher(publisher),
+     threshold(threshold), frameProcessor(), tracker(),
+     frames(depth, policy), detections(depth, policy),
+     running(false), nbCaptured(0), nbProcessed(0), nbPublished(0), nbUnsteady(0)
+{
+    LOG(INFO) << __PRETTY_FUNCTION__;
+    frameProcessor.setLatencies(&fc.latencies());
+}
+
+DetectionPipeline::DetectionPipeline(Source source, int threshold, Publisher publisher,
+                                     unsigned int depth, Policy policy)
+    :source(source), publisher(publisher),
+     threshold(threshold), frameProcessor(), tracker(),
+     frames(depth, policy), detections(depth, policy),
+     running(false), nbCaptured(0), nbProcessed(0), nbPublished(0), nbUnsteady(0)
+{
+    LOG(INFO) << __PRETTY_FUNCTION__;
+}
+
+DetectionPipeline::~DetectionPipeline()
+{
+    LOG(INFO) << __PRETTY_FUNCTION__;
+    stop();
+}
+
+void DetectionPipeline::setRoiMode(bool enabled, unsigned int fullScanPeriod, int margin) {
+    frameProcessor.setRoiMode(enabled, fullScanPeriod, margin);
+}
+
+void DetectionPipeline::setPyramidMode(unsigned int factor) {
+    frameProcessor.setPyramidMode(factor);
+}
+
+void DetectionPipeline::setLatencies(StageLatencies* latencies) {
+    frameProcessor.setLatencies(latencies);
+}
+
+void DetectionPipeline::start() {
+    LOG(INFO) << __PRETTY_FUNCTION__;
+    running = true;
+    publishThread = std::thread(&DetectionPipeline::publish, this);
+    processThread = std::thread(&DetectionPipeline::process, this);
+    captureThread = std::thread(&DetectionPipeline::capture, this);
+}
+
+void DetectionPipeline::stop() {
+    running = false;
+    join();
+}
+
+void DetectionPipeline::join() {
+    if (captureThread.joinable())
+        captureThread.join();
+    if (processThread.joinable())
+        processThread.join();
+    if (publishThread.joinable())
+        publishThread.join();
+}
+
+void DetectionPipeline::capture() {
+    try {
+        while (running) {
+            FrameBuffer::Ptr frame = source();
+            if (!frame)
+                break;
+            ++nbCaptured;
+            if (!frame->steady) {
+                ++nbUnsteady;
+                continue;
+            }
+            frames.push(frame);
+        }
+    }
+    catch(mirage::Exception::Any& e) {
+        LOG(ERROR) << "Error : " <<  e.what();
+    }
+    catch(...) {
+        LOG(ERROR) << "Unknown error";
+    }
+    frames.close();
+}
+
+void DetectionPipeline::process() {
+    FrameBuffer::Ptr frame;
+    while (frames.pop(frame)) {
+        // A frame which fails is dropped, the next ones are processed.
+        try {
+            Detections d;
+            d.camera = 0;
+            d.sequence = frame->sequence;
+            d.time = frame->time;
+            d.pan = frame->pan;
+            d.tilt = frame->tilt;
+            d.zoom = frame->zoom;
+
+            frameProcessor.setFrame(frame);
+            frame.reset();
+            frameProcessor.filterColor(threshold);
+            d.positions = frameProcessor.findPositions();
+            tracker.update(d.positions, d.time);
+            d.ids = tracker.ids();
+            ++nbProcessed;
+            detections.push(d);
+        }
+        catch(mirage::Exception::Any& e) {
+            LOG(ERROR) << "Error : " <<  e.what();
+        }
+        catch(std::exception& e) {
+            LOG(ERROR) << "Error : " <<  e.what();
+        }
+        catch(...) {
+            LOG(ERROR) << "Unknown error";
+        }
+        frame.reset();
+    }
+    detections.close();
+}
+
+void DetectionPipeline::publish() {
+    Detections d;
+    while (detections.pop(d)) {
+        try {
+            publisher(d);
+        }
+        catch(std::exception& e) {
+            LOG(ERROR) << "Error : " <<  e.what();
+        }
+        ++nbPublished;
+    }
+}
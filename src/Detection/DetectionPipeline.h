@@ -0,0 +1,93 @@
+#ifndef DETECTIONPIPELINE_H
+#define DETECTIONPIPELINE_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "BoundedQueue.h"
+#include "FrameBuffer.h"
+#include "FrameProcessor.h"
+#include "TargetTracker.h"
+
+class FrameCapturer;
+
+// What the processing stage found in one frame.
+struct Detections {
+    unsigned int camera;                    // index in a MultiCameraTracker
+    unsigned long sequence;
+    double time;                            // capture time, see FrameBuffer
+    double pan, tilt, zoom;                 // pose of the frame
+    std::vector<PanTiltCentered> positions; // pose centering each target
+    std::vector<unsigned int> ids;          // TargetTracker track of each position
+};
+
+// Capture, processing (filterColor + findPositions + tracking) and
+// publishing run on three threads, connected by bounded queues. The
+// capture stage waits on the network while the previous frame is
+// processed.
+//
+// With the DropOldest policy (default), a full queue discards its oldest
+// entry, so that the processing always works on the latest frame. With
+// Block, a full queue stalls the stage upstream.
+class DetectionPipeline
+{
+    public:
+        // Returns the next frame, or a null pointer at the end of the
+        // stream.
+        typedef std::function<FrameBuffer::Ptr ()> Source;
+        typedef std::function<void (const Detections&)> Publisher;
+        typedef BoundedQueueBase::Policy Policy;
+
+        DetectionPipeline(FrameCapturer& fc, int threshold, Publisher publisher,
+                          unsigned int depth = 2,
+                          Policy policy = BoundedQueueBase::DropOldest);
+        DetectionPipeline(Source source, int threshold, Publisher publisher,
+                          unsigned int depth = 2,
+                          Policy policy = BoundedQueueBase::DropOldest);
+        ~DetectionPipeline();
+
+        // See FrameProcessor::setRoiMode. To be called before start.
+        void setRoiMode(bool enabled, unsigned int fullScanPeriod = 15, int margin = 24);
+        // See FrameProcessor::setPyramidMode. To be called before start.
+        void setPyramidMode(unsigned int factor);
+        // See FrameProcessor::setLatencies : those of the capturer, or
+        // none with a Source. To be called before start.
+        void setLatencies(StageLatencies* latencies);
+
+        void start();
+        // Stops the capture, lets the frames already queued go through the
+        // other stages, and joins the threads.
+        void stop();
+        // Waits for the end of the source.
+        void join();
+
+        unsigned long captured() const { return nbCaptured; }
+        unsigned long processed() const { return nbProcessed; }
+        unsigned long published() const { return nbPublished; }
+        unsigned long dropped() const { return frames.dropped() + detections.dropped(); }
+        // Frames not processed because the camera was moving or not
+        // settled yet (see FrameBuffer::steady).
+        unsigned long unsteady() const { return nbUnsteady; }
+
+    protected:
+    private:
+        Source source;
+        Publisher publisher;
+        int threshold;
+        FrameProcessor frameProcessor;
+        TargetTracker tracker;
+
+        BoundedQueue<FrameBuffer::Ptr> frames;
+        BoundedQueue<Detections> detections;
+
+        std::atomic<bool> running;
+        std::atomic<unsigned long> nbCaptured, nbProcessed, nbPublished, nbUnsteady;
+        std::thread captureThread, processThread, publishThread;
+
+        void capture();
+        void process();
+        void publish();
+};
+
+#endif // DETECTIONPIPELINE_H
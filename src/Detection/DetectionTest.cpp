@@ -1,12 +1,19 @@
 #include <string>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <thread>
 #include <glog/logging.h>
 #include "FrameCapturer.h"
 #include "FrameProcessor.h"
+#include "DetectionPipeline.h"
+#include "TraceLog.h"
 
 void loggerInit(char* argv0) {
     google::InitGoogleLogging(argv0);
     FLAGS_logtostderr = 1;
     FLAGS_minloglevel = 0;
+    TraceLog::start();
 }
 
 int main(int argc, char* argv[]) {
@@ -23,7 +30,7 @@ int main(int argc, char* argv[]) {
     fp.nextFrame();
     fp.writeFrame("output1.jpg");
     fp.filterColor(35);
-    fp.writeFrame("output2.jpg");
+    fp.writeMask("output2.ppm");
     std::vector<std::pair<double, double>> pt;
     pt = fp.findPositions();
     fc.setPanTilt(pt[0].first, pt[0].second);
@@ -32,6 +39,45 @@ int main(int argc, char* argv[]) {
         std::cout << i.first << std::endl;
         std::cout << i.second << std::endl;
     }
+
+    // Continuous tracking for <seconds> (first argument), capture and
+    // processing overlapping. The camera follows the same target as long
+    // as it is tracked, and is not moved for less than 0.2 degrees.
+    int seconds = argc > 1 ? atoi(argv[1]) : 0;
+    if (seconds > 0) {
+        unsigned int followed = 0;
+        PanTiltCentered aimed;
+        double zoom;
+        fc.getPanTiltZoom(aimed.first, aimed.second, zoom);
+        DetectionPipeline pipeline(fc, 35, [&fc, &followed, &aimed](const Detections& d) {
+            std::cout << "frame " << d.sequence << ": "
+                      << d.positions.size() << " targets" << std::endl;
+            if (d.positions.empty())
+                return;
+            unsigned int i = 0;
+            while (i < d.positions.size() && d.ids[i] != followed)
+                ++i;
+            if (i == d.positions.size()) {
+                i = 0;
+                followed = d.ids[0];
+                std::cout << "following target " << followed << std::endl;
+            }
+            PanTiltCentered target = d.positions[i];
+            // The move goes on while the next frames are processed, and
+            // is replaced by the next one if still waiting.
+            if (std::fabs(target.first - aimed.first) > 0.2 || std::fabs(target.second - aimed.second) > 0.2) {
+                fc.movePanTilt(target.first, target.second);
+                aimed = target;
+            }
+        });
+        pipeline.start();
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        pipeline.stop();
+        std::cout << "captured: " << pipeline.captured()
+                  << " processed: " << pipeline.processed()
+                  << " dropped: " << pipeline.dropped()
+                  << " unsteady: " << pipeline.unsteady() << std::endl;
+    }
     //fp.nextFakeFrame("fakeFrame2.jpg");
     //fp.filterColor(40);
     //fp.writeFrame("output2.jpg");
@@ -0,0 +1,298 @@
+/*
+
+  Local stand-in for an Axis PTZ camera, serving the frames of a
+  directory such as PlayGround/.
+
+  g++ -o fake-axis -Wall -ansi -O3 fake-axis.cc -std=c++0x `pkg-config --cflags --libs mirage` -lpthread -lboost_system-mt -lboost_filesystem
+
+  The frames must be named after their pose (see PoseFilename.h). The
+  camera answers with the frame whose pose is the closest to the current
+  one, which is moved by the ptz.cgi requests. Handled requests :
+
+    /axis-cgi/com/ptz.cgi?query=position          -> pan=..  tilt=..  zoom=..
+    /axis-cgi/com/ptz.cgi?pan=..&tilt=..&zoom=..  (also rpan, rtilt, rzoom)
+    /axis-cgi/jpg/image.cgi                       -> frame as JPEG
+    /axis-cgi/mjpg/video.cgi[?fps=..]             -> multipart JPEG stream of the
+                                                     current frame (25 fps by default)
+    /axis-cgi/bitmap/image.bmp                    -> frame as 24 bits BMP
+
+  Any other request gets an empty 200 answer. Authentication is ignored.
+
+*/
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <map>
+#include <vector>
+
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include <mirage.h>
+
+#include "../PoseFilename.h"
+
+typedef mirage::img::Coding<mirage::colorspace::RGB_24>::Frame ImageRGB;
+
+struct Frame {
+  FramePose   pose;
+  std::string path;
+  std::string jpeg;
+  std::string bmp;  // built on first request
+};
+
+class Camera {
+
+private:
+
+  std::vector<Frame> frames;
+  double pan, tilt, zoom;
+  std::mutex lock;
+
+  static std::string readFile(const std::string& path) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+  }
+
+  static void putLE(std::string& out, uint32_t value, int nbBytes) {
+    for(int i = 0; i < nbBytes; ++i)
+      out += (char)((value >> (8*i)) & 0xff);
+  }
+
+  // Bottom-up BGR rows, padded to 4 bytes, as the camera sends them.
+  static std::string toBMP(const std::string& path) {
+    ImageRGB img;
+    mirage::img::JPEG::read(img, path);
+    int width  = img._dimension[0];
+    int height = img._dimension[1];
+    int stride = (3*width + 3) & ~3;
+    uint32_t size = 54 + stride*height;
+
+    std::string bmp("BM");
+    putLE(bmp, size, 4);
+    putLE(bmp, 0, 4);
+    putLE(bmp, 54, 4);
+    putLE(bmp, 40, 4);
+    putLE(bmp, width, 4);
+    putLE(bmp, height, 4);
+    putLE(bmp, 1, 2);
+    putLE(bmp, 24, 2);
+    putLE(bmp, 0, 4);
+    putLE(bmp, stride*height, 4);
+    putLE(bmp, 2835, 4);
+    putLE(bmp, 2835, 4);
+    putLE(bmp, 0, 4);
+    putLE(bmp, 0, 4);
+
+    const unsigned char* pixels = (const unsigned char*)&(*img.begin());
+    for(int y = height - 1; y >= 0; --y) {
+      const unsigned char* row = pixels + 3*width*y;
+      for(int x = 0; x < width; ++x) {
+        bmp += (char)row[3*x + 2];
+        bmp += (char)row[3*x + 1];
+        bmp += (char)row[3*x];
+      }
+      for(int pad = 3*width; pad < stride; ++pad)
+        bmp += '\0';
+    }
+    return bmp;
+  }
+
+  Frame& closest(void) {
+    unsigned int best = 0;
+    double best_dist = -1;
+    for(unsigned int i = 0; i < frames.size(); ++i) {
+      const FramePose& p = frames[i].pose;
+      double dz = (p.zoom - zoom)/100.0;
+      double d  = (p.pan - pan)*(p.pan - pan) + (p.tilt - tilt)*(p.tilt - tilt) + dz*dz;
+      if(best_dist < 0 || d < best_dist) {
+        best = i;
+        best_dist = d;
+      }
+    }
+    return frames[best];
+  }
+
+public:
+
+  Camera(const std::string& dir) : frames(), pan(0), tilt(0), zoom(1), lock() {
+    boost::filesystem::directory_iterator it(dir), eod;
+    for(; it != eod; ++it) {
+      Frame frame;
+      frame.path = it->path().string();
+      if(parsePoseFilename(frame.path, frame.pose)) {
+        frame.jpeg = readFile(frame.path);
+        frames.push_back(frame);
+      }
+    }
+    if(frames.empty())
+      throw std::runtime_error("no frame named X_<x>Y_<y>pan_<pan>tilt_<tilt>zoom_<zoom>.jpg in " + dir);
+    pan  = frames[0].pose.pan;
+    tilt = frames[0].pose.tilt;
+    zoom = frames[0].pose.zoom;
+  }
+
+  unsigned int size(void) const {return frames.size();}
+
+  std::string position(void) {
+    std::unique_lock<std::mutex> exclusion(lock);
+    std::ostringstream os;
+    os << "pan=" << pan << "\r\ntilt=" << tilt << "\r\nzoom=" << zoom << "\r\n";
+    return os.str();
+  }
+
+  void move(std::map<std::string,std::string>& args) {
+    std::unique_lock<std::mutex> exclusion(lock);
+    if(args.count("pan"))   pan   = atof(args["pan"].c_str());
+    if(args.count("tilt"))  tilt  = atof(args["tilt"].c_str());
+    if(args.count("zoom"))  zoom  = atof(args["zoom"].c_str());
+    if(args.count("rpan"))  pan  += atof(args["rpan"].c_str());
+    if(args.count("rtilt")) tilt += atof(args["rtilt"].c_str());
+    if(args.count("rzoom")) zoom += atof(args["rzoom"].c_str());
+  }
+
+  std::string jpeg(void) {
+    std::unique_lock<std::mutex> exclusion(lock);
+    return closest().jpeg;
+  }
+
+  std::string bmp(void) {
+    std::unique_lock<std::mutex> exclusion(lock);
+    Frame& frame = closest();
+    if(frame.bmp.empty())
+      frame.bmp = toBMP(frame.path);
+    return frame.bmp;
+  }
+};
+
+class ServiceThread {
+private:
+
+  typedef boost::asio::ip::tcp::iostream socket_stream;
+
+  Camera&                         camera;
+  std::shared_ptr<socket_stream>  p_socket;
+
+  // Same part layout as the Axis cameras, until the client goes away.
+  void stream(socket_stream& socket, double fps) {
+    const std::string boundary = "myboundary";
+    socket << "HTTP/1.0 200 OK\r\n"
+	   << "Content-Type: multipart/x-mixed-replace; boundary=" << boundary << "\r\n"
+	   << "Connection: close\r\n\r\n";
+    std::chrono::microseconds period((long)(1e6 / (fps > 0 ? fps : 25)));
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    while(socket) {
+      std::string jpeg = camera.jpeg();
+      socket << "--" << boundary << "\r\n"
+	     << "Content-Type: image/jpeg\r\n"
+	     << "Content-Length: " << jpeg.size() << "\r\n\r\n";
+      socket.write(jpeg.data(), jpeg.size());
+      socket << "\r\n";
+      socket.flush();
+      next += period;
+      std::this_thread::sleep_until(next);
+    }
+  }
+
+  static void answer(socket_stream& socket, const std::string& type, const std::string& body) {
+    socket << "HTTP/1.0 200 OK\r\n"
+	   << "Content-Type: " << type << "\r\n"
+	   << "Content-Length: " << body.size() << "\r\n"
+	   << "Connection: close\r\n\r\n";
+    socket.write(body.data(), body.size());
+    socket.flush();
+  }
+
+public:
+
+  ServiceThread(Camera& cam,
+		boost::asio::ip::tcp::acceptor& acceptor)
+    : camera(cam), p_socket(new socket_stream()) {
+    acceptor.accept(*(p_socket->rdbuf()));
+  }
+
+  ServiceThread(const ServiceThread& cp)
+    : camera(cp.camera), p_socket(cp.p_socket) {
+  }
+
+  void operator()(void) {
+    socket_stream& socket = *p_socket;
+    std::string method, target, line;
+
+    try {
+      socket >> method >> target;
+      std::getline(socket, line);
+      while(std::getline(socket, line) && line != "\r" && !line.empty());
+
+      std::string path = target, query;
+      std::map<std::string,std::string> args;
+      std::string::size_type q = target.find('?');
+      if(q != std::string::npos) {
+	path  = target.substr(0, q);
+	query = target.substr(q + 1);
+      }
+      std::istringstream params(query);
+      std::string param;
+      while(std::getline(params, param, '&')) {
+	std::string::size_type eq = param.find('=');
+	args[param.substr(0, eq)] = eq == std::string::npos ? "" : param.substr(eq + 1);
+      }
+
+      if(path == "/axis-cgi/com/ptz.cgi") {
+	if(args.count("query"))
+	  answer(socket, "text/plain", camera.position());
+	else {
+	  camera.move(args);
+	  answer(socket, "text/plain", "");
+	}
+      }
+      else if(path == "/axis-cgi/mjpg/video.cgi")
+	stream(socket, args.count("fps") ? atof(args["fps"].c_str()) : 25);
+      else if(path == "/axis-cgi/jpg/image.cgi")
+	answer(socket, "image/jpeg", camera.jpeg());
+      else if(path == "/axis-cgi/bitmap/image.bmp")
+	answer(socket, "image/bmp", camera.bmp());
+      else
+	answer(socket, "text/plain", "");
+    }
+    catch(std::exception& e) {
+      std::cout << "Exception : " << e.what() << std::endl;
+    }
+  }
+};
+
+
+int main(int argc, char* argv[]) {
+  if(argc!=3) {
+    std::cerr << "Usage : " << argv[0] << " <port> <frame directory>" << std::endl;
+    return 1;
+  }
+
+  try {
+    Camera                         camera(argv[2]);
+    boost::asio::io_service        ios;
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::v4(), atoi(argv[1]));
+    boost::asio::ip::tcp::acceptor acceptor(ios, endpoint);
+
+    std::cout << "Fake axis camera is started (" << camera.size() << " frames)..." << std::endl;
+    while(true) {
+      std::thread service(ServiceThread(camera,acceptor));
+      service.detach();
+    }
+  }
+  catch(std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+
+  return 0;
+}
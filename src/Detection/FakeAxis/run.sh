@@ -0,0 +1,11 @@
+#!/usr/bin/bash
+# Five fake cameras serving the PlayGround frames, tracked by one daemon.
+# Run from this directory after "make fakeaxis trackingdaemon" at the top.
+BIN=../../../bin
+for port in 8081 8082 8083 8084 8085; do
+    $BIN/FakeAxis/fake_axis $port ../PlayGround &
+done
+trap 'kill $(jobs -p)' EXIT
+sleep 1
+$BIN/TrackingDaemon/tracking_daemon demo demo 35 \
+    localhost:8081 localhost:8082 localhost:8083 localhost:8084 localhost:8085
@@ -0,0 +1,189 @@
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <lz4.h>
+#include <glog/logging.h>
+#include "FrameArchive.h"
+
+namespace {
+
+const char magic[8] = {'N', 'A', 'O', 'T', 'R', 'A', 'C', 'K'};
+const uint32_t byteOrder = 0x01020304;
+const std::size_t alignment = 64;
+
+}
+
+FrameArchive::FrameArchive()
+    :data(0), length(0), records(0), firstDetection(0)
+{
+}
+
+FrameArchive::~FrameArchive()
+{
+    close();
+}
+
+bool FrameArchive::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        LOG(ERROR) << "Error : cannot open " << path;
+        if (fd >= 0)
+            ::close(fd);
+        return false;
+    }
+    length = status.st_size;
+    void* mapped = length >= sizeof(ArchiveHeader) ? mmap(0, length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG(ERROR) << "Error : cannot map " << path;
+        length = 0;
+        return false;
+    }
+    data = (const unsigned char*)mapped;
+
+    const ArchiveHeader& h = header();
+    if (std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != ArchiveHeader::Version
+        || h.byteOrder != byteOrder || h.recordSize != sizeof(ArchiveRecord)
+        || h.detectionSize != sizeof(ArchiveDetection)
+        || h.records + h.nbRecords * sizeof(ArchiveRecord) > length
+        || h.detections + h.nbDetections * sizeof(ArchiveDetection) > length) {
+        LOG(ERROR) << "Error : " << path << " is not an archive of this version and machine";
+        close();
+        return false;
+    }
+    records = (const ArchiveRecord*)(data + h.records);
+    firstDetection = (const ArchiveDetection*)(data + h.detections);
+    // The frames are only read sequentially, or nearly.
+    madvise((void*)data, length, MADV_SEQUENTIAL);
+    return true;
+}
+
+void FrameArchive::close() {
+    if (data)
+        munmap((void*)data, length);
+    data = 0;
+    length = 0;
+    records = 0;
+    firstDetection = 0;
+}
+
+bool FrameArchive::read(std::size_t i, ImageRGB& image) const {
+    const ArchiveRecord& r = records[i];
+    std::size_t size = 3 * (std::size_t)r.width * r.height;
+    if (r.pixels + r.storedSize > length || r.storedSize > size) {
+        LOG(ERROR) << "Error : frame " << i << " out of the archive";
+        return false;
+    }
+    mirage::img::Coordinate dimension(r.width, r.height);
+    if (image._dimension[0] != dimension[0] || image._dimension[1] != dimension[1])
+        image.resize(dimension);
+    const unsigned char* stored = data + r.pixels;
+    if (r.storedSize == size) {
+        std::memcpy(imageBytes(image), stored, size);
+        return true;
+    }
+    if (LZ4_decompress_safe((const char*)stored, (char*)imageBytes(image),
+                            r.storedSize, size) != (int)size) {
+        LOG(ERROR) << "Error : frame " << i << " of the archive is corrupted";
+        return false;
+    }
+    return true;
+}
+
+FrameArchiveWriter::FrameArchiveWriter(const std::string& path, bool compressed, int threshold)
+    :path(path), file(std::fopen((path + ".tmp").c_str(), "wb")), position(0), header(),
+     records(), detections()
+{
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = ArchiveHeader::Version;
+    header.flags = compressed ? ArchiveHeader::Compressed : 0;
+    header.byteOrder = byteOrder;
+    header.recordSize = sizeof(ArchiveRecord);
+    header.detectionSize = sizeof(ArchiveDetection);
+    header.threshold = threshold;
+    if (!file)
+        LOG(ERROR) << "Error : cannot create " << path << ".tmp";
+    // Placeholder, rewritten by close.
+    else if (!write(&header, sizeof(header)))
+        close();
+}
+
+FrameArchiveWriter::~FrameArchiveWriter()
+{
+    if (file)
+        close();
+}
+
+void FrameArchiveWriter::pack(const unsigned char* pixels, std::size_t size, bool compress,
+                              std::vector<unsigned char>& stored) {
+    if (compress) {
+        stored.resize(LZ4_compressBound(size));
+        int n = LZ4_compress_default((const char*)pixels, (char*)&stored[0], size, stored.size());
+        if (n > 0 && (std::size_t)n < size) {
+            stored.resize(n);
+            return;
+        }
+    }
+    stored.assign(pixels, pixels + size);
+}
+
+bool FrameArchiveWriter::add(ArchiveRecord record, const std::vector<unsigned char>& stored,
+                             const std::vector<ArchiveDetection>& found) {
+    if (!file || !align())
+        return false;
+    record.pixels = position;
+    record.storedSize = stored.size();
+    record.firstDetection = detections.size();
+    record.nbDetections = found.size();
+    if (!stored.empty() && !write(&stored[0], stored.size()))
+        return false;
+    records.push_back(record);
+    detections.insert(detections.end(), found.begin(), found.end());
+    return true;
+}
+
+bool FrameArchiveWriter::close() {
+    if (!file)
+        return false;
+    // A failed write leaves the error flag of the file set.
+    bool written = !std::ferror(file) && align();
+    header.nbRecords = records.size();
+    header.records = position;
+    if (written && !records.empty())
+        written = write(&records[0], records.size() * sizeof(ArchiveRecord));
+    header.nbDetections = detections.size();
+    header.detections = position;
+    if (written && !detections.empty())
+        written = write(&detections[0], detections.size() * sizeof(ArchiveDetection));
+    written = written && std::fseek(file, 0, SEEK_SET) == 0
+        && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    written = std::fclose(file) == 0 && written;
+    file = 0;
+    std::string temporary = path + ".tmp";
+    if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        LOG(ERROR) << "Error : cannot write " << path;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool FrameArchiveWriter::write(const void* bytes, std::size_t size) {
+    if (std::fwrite(bytes, 1, size, file) != size) {
+        LOG(ERROR) << "Error : cannot write " << path << ".tmp";
+        return false;
+    }
+    position += size;
+    return true;
+}
+
+bool FrameArchiveWriter::align() {
+    static const char zeros[alignment] = {0};
+    std::size_t padding = (alignment - position % alignment) % alignment;
+    return padding == 0 || write(zeros, padding);
+}
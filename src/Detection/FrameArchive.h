@@ -0,0 +1,134 @@
+#ifndef FRAMEARCHIVE_H
+#define FRAMEARCHIVE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "FrameBuffer.h"
+
+// Single file holding recorded frames, their pose and the targets found in
+// them, laid out to be memory mapped and read in place :
+//
+//     ArchiveHeader
+//     pixels of each frame, packed RGB, 64 bytes aligned, each either raw
+//         or compressed as one LZ4 block
+//     ArchiveRecord[nbRecords]
+//     ArchiveDetection[nbDetections]
+//
+// All the values are in the byte order of the machine which wrote the
+// archive, the header telling which one it was. Offsets are from the start
+// of the file.
+
+struct ArchiveHeader {
+    enum { Version = 1, Compressed = 1 };
+
+    char magic[8];              // "NAOTRACK"
+    uint32_t version;
+    uint32_t flags;             // Compressed if LZ4 was used
+    uint32_t byteOrder;         // 0x01020304 written natively
+    uint32_t recordSize;        // sizeof(ArchiveRecord)
+    uint32_t detectionSize;     // sizeof(ArchiveDetection)
+    int32_t threshold;          // of the detection
+    uint64_t nbRecords, records;
+    uint64_t nbDetections, detections;
+};
+
+struct ArchiveRecord {
+    double pan, tilt, zoom;
+    double time;                // of the capture, see FrameBuffer::time
+    double x, y;                // floor position of the target (PoseFilename.h)
+    uint32_t width, height;
+    uint64_t pixels;
+    // Bytes at pixels : the frame is compressed if less than 3 width height.
+    uint64_t storedSize;
+    // Targets found, detections[firstDetection...].
+    uint32_t firstDetection, nbDetections;
+    char name[64];              // of the file the frame came from, truncated
+};
+
+struct ArchiveDetection {
+    double pan, tilt;           // pose centering the target
+};
+
+// Read only view of an archive. The records and detections are used in
+// place, and read is const : it may be called from several threads.
+class FrameArchive
+{
+    public:
+        FrameArchive();
+        ~FrameArchive();
+
+        // Maps the file. Returns false, logging why, if it is not a
+        // readable archive.
+        bool open(const std::string& path);
+        void close();
+
+        const ArchiveHeader& header() const { return *(const ArchiveHeader*)data; }
+        std::size_t size() const { return data ? header().nbRecords : 0; }
+        const ArchiveRecord& record(std::size_t i) const { return records[i]; }
+        // record(i).nbDetections of them.
+        const ArchiveDetection* detections(std::size_t i) const {
+            return firstDetection + records[i].firstDetection;
+        }
+        // Frame i, uncompressed if needed, into image (whose allocation is
+        // reused when the size does not change).
+        bool read(std::size_t i, ImageRGB& image) const;
+
+    protected:
+    private:
+        const unsigned char* data;
+        std::size_t length;
+        const ArchiveRecord* records;
+        const ArchiveDetection* firstDetection;
+
+        FrameArchive(const FrameArchive&);
+        FrameArchive& operator=(const FrameArchive&);
+};
+
+// Writes an archive, one frame after the other. The file is written under
+// a temporary name, renamed once closed, so that an archive which exists
+// is complete.
+class FrameArchiveWriter
+{
+    public:
+        FrameArchiveWriter(const std::string& path, bool compressed, int threshold);
+        // Closes the archive if close was not called.
+        ~FrameArchiveWriter();
+
+        bool isOpen() const { return file != 0; }
+
+        // Stored form of the size bytes of pixels : an LZ4 block if the
+        // archive is compressed and if that is smaller, the pixels
+        // themselves otherwise. Independent of the writer state, to be run
+        // in parallel.
+        static void pack(const unsigned char* pixels, std::size_t size, bool compress,
+                         std::vector<unsigned char>& stored);
+
+        // record is completed with the offsets. stored comes from pack.
+        bool add(ArchiveRecord record, const std::vector<unsigned char>& stored,
+                 const std::vector<ArchiveDetection>& detections);
+        bool close();
+
+        bool compressed() const { return header.flags & ArchiveHeader::Compressed; }
+        // Bytes written so far.
+        uint64_t written() const { return position; }
+
+    protected:
+    private:
+        std::string path;
+        std::FILE* file;
+        uint64_t position;
+        ArchiveHeader header;
+        std::vector<ArchiveRecord> records;
+        std::vector<ArchiveDetection> detections;
+
+        bool write(const void* bytes, std::size_t size);
+        bool align();
+
+        FrameArchiveWriter(const FrameArchiveWriter&);
+        FrameArchiveWriter& operator=(const FrameArchiveWriter&);
+};
+
+#endif // FRAMEARCHIVE_H
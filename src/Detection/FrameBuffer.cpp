@@ -0,0 +1,67 @@
+#include <chrono>
+#include <cstring>
+#include "FrameBuffer.h"
+
+FrameBuffer::FrameBuffer()
+    :image(), bgr(false), pan(0), tilt(0), zoom(0), sequence(0), time(0), steady(true), calibration()
+{
+}
+
+double FrameBuffer::now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameBuffer::assign(const mirage::img::Coordinate& size, const unsigned char* bytes) {
+    mirage::img::Coordinate current = image._dimension;
+    if (current[0] == size[0] && current[1] == size[1] && size[0] * size[1] > 0)
+        std::memcpy(imageBytes(image), bytes, 3 * size[0] * size[1]);
+    else
+        image.resize(size, (ImageRGB::value_type*)bytes);
+}
+
+FramePool::FramePool(unsigned int capacity)
+    :store(new Store())
+{
+    store->capacity = capacity;
+    store->sequence = 0;
+}
+
+FramePool::~FramePool()
+{
+}
+
+FrameBuffer::Ptr FramePool::acquire() {
+    FrameBuffer* buffer = 0;
+    unsigned long sequence;
+    {
+        std::unique_lock<std::mutex> exclusion(store->lock);
+        if (!store->free.empty()) {
+            buffer = store->free.back();
+            store->free.pop_back();
+        }
+        sequence = ++store->sequence;
+    }
+    if (buffer == 0)
+        buffer = new FrameBuffer();
+    buffer->sequence = sequence;
+
+    Recycler recycler;
+    recycler.store = store;
+    return FrameBuffer::Ptr(buffer, recycler);
+}
+
+FramePool::Store::~Store() {
+    for (unsigned int i = 0; i < free.size(); ++i)
+        delete free[i];
+}
+
+void FramePool::Store::release(FrameBuffer* buffer) {
+    {
+        std::unique_lock<std::mutex> exclusion(lock);
+        if (free.size() < capacity) {
+            free.push_back(buffer);
+            return;
+        }
+    }
+    delete buffer;
+}
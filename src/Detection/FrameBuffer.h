@@ -0,0 +1,76 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <mirage.h>
+#include "Calibration.h"
+
+typedef mirage::img::Coding<mirage::colorspace::RGB_24>::Frame ImageRGB;
+
+// Packed 24 bits pixels of an image, as expected by ColorFilter.
+inline unsigned char* imageBytes(ImageRGB& img) {
+    return (unsigned char*)&(*img.begin());
+}
+
+// A captured frame and the camera pose it was taken at. Buffers are
+// handed out by a FramePool and shared by pointer between the capturer
+// and the processors : the image itself is never copied.
+class FrameBuffer
+{
+    public:
+        typedef std::shared_ptr<FrameBuffer> Ptr;
+
+        FrameBuffer();
+
+        // Seconds of the steady clock, the time base of FrameBuffer::time.
+        static double now();
+
+        // Copies size[0]*size[1] packed pixels into image, reusing the
+        // current allocation when the size does not change.
+        void assign(const mirage::img::Coordinate& size, const unsigned char* bytes);
+
+        ImageRGB image;
+        bool bgr;            // red and blue are still swapped (camera order)
+        double pan, tilt, zoom;
+        unsigned long sequence;
+        double time;         // of the capture, see now()
+        // No camera move under way, image settled (see FrameCapturer).
+        bool steady;
+        // Of the camera the frame comes from, null for the standard one.
+        Calibration::Ptr calibration;
+};
+
+// Recycles FrameBuffers once the last pointer on them is released. The
+// pool never blocks : when no buffer is free, a new one is allocated, and
+// at most capacity buffers are kept for reuse.
+class FramePool
+{
+    public:
+        FramePool(unsigned int capacity);
+        ~FramePool();
+
+        FrameBuffer::Ptr acquire();
+
+    private:
+        struct Store {
+            std::mutex lock;
+            std::vector<FrameBuffer*> free;
+            unsigned int capacity;
+            unsigned long sequence;
+
+            ~Store();
+            void release(FrameBuffer* buffer);
+        };
+
+        struct Recycler {
+            std::shared_ptr<Store> store;
+            void operator()(FrameBuffer* buffer) { store->release(buffer); }
+        };
+
+        // Shared with the Recyclers, so that buffers may outlive the pool.
+        std::shared_ptr<Store> store;
+};
+
+#endif // FRAMEBUFFER_H
@@ -1,16 +1,31 @@
+#include <chrono>
+#include <fstream>
+#include <iterator>
 #include <glog/logging.h>
 #include "FrameCapturer.h"
+#include "ColorFilter.h"
+#include "TraceLog.h"
 
 FrameCapturer::FrameCapturer(string host, int port, string user, string password)
-    :host(host), port(port), username(user), password(password), axis(host, port)
+    :host(host), port(port), username(user), password(password),
+     calibration(Calibration::load(host, port)),
+     captureLock(), axisLock(), axis(host, port), pool(4),
+     control(host, port), controlLock(), controlChanged(), goal(),
+     moveInProgress(false), stopping(false), zoomSettle(2000), controlThread(),
+     moveGeneration(0), inMotion(false), settle(), settleGeneration(0), settledMove(0),
+     settleStart(std::chrono::steady_clock::now()), settleTimedOut(false),
+     stream(), snapshots(), jpeg(), decoder(), jpegScale(1), lastPan(0), lastTilt(0), lastZoom(0), poseGeneration(0), poseKnown(false),
+     stageLatencies()
 {
-    LOG(INFO) << __PRETTY_FUNCTION__;
+    TRACE_CALL();
     LOG(INFO) << "host: " << host;
     LOG(INFO) << "port: " << port;
     LOG(INFO) << "username: " << user;
     LOG(INFO) << "password: " << password;
 
     init();
+    goal.panTilt = goal.zoom = false;
+    controlThread = std::thread(&FrameCapturer::controlLoop, this);
 }
 
 //FrameCapturer::FrameCapturer(FrameCapturer& fc)
@@ -27,66 +42,312 @@ FrameCapturer::FrameCapturer(string host, int port, string user, string password
 
 FrameCapturer::~FrameCapturer()
 {
-    LOG(INFO) << __PRETTY_FUNCTION__;
+    TRACE_CALL();
+    {
+        std::unique_lock<std::mutex> exclusion(controlLock);
+        stopping = true;
+        controlChanged.notify_all();
+    }
+    controlThread.join();
+    stream.reset();
+    snapshots.reset();
+    control.end();
     axis.end();
 }
 
 void FrameCapturer::getPanTiltZoom(double &pan, double &tilt, double &zoom){
-    LOG(INFO) << __PRETTY_FUNCTION__;
-    axis.getPosition(pan, tilt, zoom);
-    LOG(INFO) << "Pan: " << pan;
-    LOG(INFO) << "Tilt: " << tilt;
-    LOG(INFO) << "Zoom: " << zoom;
+    TRACE_CALL();
+    std::unique_lock<std::mutex> exclusion(axisLock);
+    {
+        StageLatencies::Timer timer(&stageLatencies, StageLatencies::Pose);
+        axis.getPosition(pan, tilt, zoom);
+    }
+    TRACE_FRAME("Pan: {} Tilt: {} Zoom: {}", pan, tilt, zoom);
 }
 
 void FrameCapturer::setPanTilt(double &pan, double &tilt) {
-    LOG(INFO) << __PRETTY_FUNCTION__;
-    LOG(INFO) << "Pan: " << pan;
-    LOG(INFO) << "Tilt: " << tilt;
-
-    axis.setPanTilt(pan, tilt);
-    axis.wait();
+    movePanTilt(pan, tilt).wait();
 }
 
 void FrameCapturer::setZoom(double zoom){
-    LOG(INFO) << __PRETTY_FUNCTION__;
-    LOG(INFO) << "Zoom: " << zoom;
+    moveZoom(zoom).wait();
+}
+
+std::future<bool> FrameCapturer::movePanTilt(double pan, double tilt) {
+    TRACE_CALL();
+    TRACE_FRAME("Pan: {} Tilt: {}", pan, tilt);
+
+    std::unique_lock<std::mutex> exclusion(controlLock);
+    if (goal.panTilt)
+        goal.panTiltDone.set_value(false);
+    goal.panTiltDone = std::promise<bool>();
+    goal.panTilt = true;
+    goal.pan = pan;
+    goal.tilt = tilt;
+    controlChanged.notify_all();
+    return goal.panTiltDone.get_future();
+}
+
+std::future<bool> FrameCapturer::moveZoom(double zoom) {
+    TRACE_CALL();
+    TRACE_FRAME("Zoom: {}", zoom);
+
+    std::unique_lock<std::mutex> exclusion(controlLock);
+    if (goal.zoom)
+        goal.zoomDone.set_value(false);
+    goal.zoomDone = std::promise<bool>();
+    goal.zoom = true;
+    goal.zoomValue = zoom;
+    controlChanged.notify_all();
+    return goal.zoomDone.get_future();
+}
+
+void FrameCapturer::setZoomSettle(unsigned int milliseconds) {
+    std::unique_lock<std::mutex> exclusion(controlLock);
+    zoomSettle = milliseconds;
+}
 
-    axis.setZoom(zoom);
-    axis.wait();
-    ost::Thread::sleep(2000);
+bool FrameCapturer::moving() {
+    std::unique_lock<std::mutex> exclusion(controlLock);
+    return moveInProgress || goal.panTilt || goal.zoom;
 }
 
-ImageRGB FrameCapturer::getFrame(){
-    LOG(INFO) << __PRETTY_FUNCTION__;
+// Takes the whole goal at once : a pan/tilt and a zoom requested together
+// are sent one after the other, and waited for once.
+void FrameCapturer::controlLoop() {
+    std::unique_lock<std::mutex> exclusion(controlLock);
+    while (true) {
+        while (!stopping && !goal.panTilt && !goal.zoom)
+            controlChanged.wait(exclusion);
+        if (stopping)
+            break;
+
+        bool panTilt = goal.panTilt, zoom = goal.zoom;
+        double pan = goal.pan, tilt = goal.tilt, zoomValue = goal.zoomValue;
+        std::promise<bool> panTiltDone, zoomDone;
+        if (panTilt)
+            panTiltDone = std::move(goal.panTiltDone);
+        if (zoom)
+            zoomDone = std::move(goal.zoomDone);
+        goal.panTilt = goal.zoom = false;
+        moveInProgress = true;
+        unsigned int settleTimeout = zoomSettle;
+        // inMotion first : a capture which sees the new generation sees
+        // the move under way (see grabFrame).
+        inMotion = true;
+        unsigned long generation = ++moveGeneration;
+        exclusion.unlock();
+
+        bool done = false;
+        std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+        try {
+            if (panTilt)
+                control.setPanTilt(pan, tilt);
+            if (zoom)
+                control.setZoom(zoomValue);
+            control.wait();
+            done = true;
+            stageLatencies.record(StageLatencies::Ptz, sent);
+        }
+        catch(mirage::Exception::Any& e) {
+            LOG(ERROR) << "Error : " <<  e.what();
+        }
+        catch(...) {
+            LOG(ERROR) << "Unknown error";
+        }
+        inMotion = false;
+        if (panTilt)
+            panTiltDone.set_value(done);
+
+        exclusion.lock();
+        // Waits for the autofocus, as seen on the frames grabbed meanwhile.
+        if (zoom && done)
+            controlChanged.wait_for(exclusion, std::chrono::milliseconds(settleTimeout),
+                                    [this, generation]() { return stopping || settledMove == generation; });
+        if (zoom)
+            zoomDone.set_value(done && !stopping);
+        moveInProgress = false;
+    }
+
+    // Goals never sent.
+    if (goal.panTilt)
+        goal.panTiltDone.set_value(false);
+    if (goal.zoom)
+        goal.zoomDone.set_value(false);
+    goal.panTilt = goal.zoom = false;
+}
+
+ImageRGB FrameCapturer::getFrame(bool swapChannels){
+    TRACE_CALL();
     //TODO
     //int width, height, depth;
     //unsigned char *imgBytes = axis.getImageBytes(width, height, depth);
     //mirage::img::Coordinate img_size(width, height);
 
+    std::unique_lock<std::mutex> exclusion(axisLock);
     axis.getDefaultBMPImage();
     int dummy;
     mirage::img::Coordinate img_size(axis.getWidth(), axis.getHeight());
     frame.resize(img_size,
             (ImageRGB::value_type*)axis.getImageBytes(dummy, dummy, dummy));
-    rgb2bgr(frame);
+    if (swapChannels) {
+        StageLatencies::Timer timer(&stageLatencies, StageLatencies::Conversion);
+        rgb2bgr(frame);
+    }
     return frame;
 }
 
 ImageRGB FrameCapturer::getFakeFrame(std::string filename) {
-    LOG(INFO) << __PRETTY_FUNCTION__;
+    TRACE_CALL();
     //if(fakeFrame == nullptr) {
-    LOG(INFO) << "Init fakeFrame...";
+    TRACE_FRAME("Init fakeFrame...");
     mirage::img::JPEG::read(fakeFrame, filename);
     //}
     return fakeFrame;
 }
 
+FrameBuffer::Ptr FrameCapturer::grabFrame() {
+    TRACE_CALL();
+    StageLatencies::Timer timer(&stageLatencies, StageLatencies::Capture);
+    FrameBuffer::Ptr buffer = pool.acquire();
+    std::unique_lock<std::mutex> exclusion(captureLock);
+    // The JPEG frame is waited for before locking the axis connection, so
+    // that the pose queries of other threads do not wait for it.
+    bool jpegFrame = (stream || snapshots) && readJpeg(*buffer);
+    // The generation before inMotion, in the reverse order of controlLoop,
+    // so that a move which started is never taken as over.
+    unsigned long generation = moveGeneration;
+    bool moving = inMotion;
+    {
+        std::unique_lock<std::mutex> axisExclusion(axisLock);
+        if (jpegFrame)
+            readPose(*buffer, moving, generation);
+        else {
+            // A stream which stopped sending falls back on single bitmaps.
+            {
+                StageLatencies::Timer timer(&stageLatencies, StageLatencies::Pose);
+                axis.getPosition(buffer->pan, buffer->tilt, buffer->zoom);
+            }
+            generation = moveGeneration;
+            moving = inMotion;
+
+            // The axis library reuses its own buffer for the next image,
+            // this copy is the only one made on the frame.
+            axis.getDefaultBMPImage();
+            buffer->time = FrameBuffer::now();
+            int dummy;
+            mirage::img::Coordinate img_size(axis.getWidth(), axis.getHeight());
+            buffer->assign(img_size, axis.getImageBytes(dummy, dummy, dummy));
+            buffer->bgr = true;
+        }
+    }
+    buffer->calibration = calibration;
+
+    // Frames are only scored from the end of a move until the image is
+    // settled, or until the zoom settle time has passed : a scene which
+    // keeps changing would never settle.
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (moving || generation != settleGeneration) {
+        settle.reset();
+        settleGeneration = generation;
+        settleStart = now;
+        settleTimedOut = false;
+    }
+    bool settled = settle.settled() || settleTimedOut;
+    if (!moving && !settled) {
+        if (settle.add(imageBytes(buffer->image), buffer->image._dimension[0], buffer->image._dimension[1])) {
+            LOG(INFO) << "Settled, sharpness: " << settle.score();
+            settled = true;
+        }
+        std::unique_lock<std::mutex> exclusion(controlLock);
+        if (!settled && now - settleStart >= std::chrono::milliseconds(zoomSettle)) {
+            LOG(WARNING) << "Not settled after " << zoomSettle << " ms, sharpness: " << settle.score();
+            settleTimedOut = settled = true;
+        }
+        if (settled) {
+            settledMove = generation;
+            controlChanged.notify_all();
+        }
+    }
+    buffer->steady = !moving && settled;
+    return buffer;
+}
+
+bool FrameCapturer::readJpeg(FrameBuffer& buffer) {
+    if (stream ? !stream->next(jpeg, 2000) : !snapshots->get("/axis-cgi/jpg/image.cgi", jpeg)) {
+        LOG(ERROR) << "Error : no JPEG frame from " << host;
+        return false;
+    }
+    buffer.time = FrameBuffer::now();
+    {
+        StageLatencies::Timer timer(&stageLatencies, StageLatencies::Conversion);
+        if (!decoder.decode(jpeg.data(), jpeg.size(), buffer.image, jpegScale)) {
+            LOG(ERROR) << "Error : invalid JPEG frame from " << host;
+            return false;
+        }
+    }
+    buffer.bgr = false;
+    return true;
+}
+
+void FrameCapturer::readPose(FrameBuffer& buffer, bool moving, unsigned long generation) {
+    if (moving || !poseKnown || generation != poseGeneration) {
+        StageLatencies::Timer timer(&stageLatencies, StageLatencies::Pose);
+        axis.getPosition(lastPan, lastTilt, lastZoom);
+        poseGeneration = generation;
+        poseKnown = !moving;
+    }
+    buffer.pan = lastPan;
+    buffer.tilt = lastTilt;
+    buffer.zoom = lastZoom;
+}
+
+void FrameCapturer::setStreaming(bool enabled, unsigned int fps) {
+    TRACE_CALL();
+    std::unique_lock<std::mutex> exclusion(captureLock);
+    stream.reset();
+    poseKnown = false;
+    if (enabled) {
+        stream.reset(new MjpegStream(host, port, username, password, fps));
+        stream->start();
+    }
+}
+
+void FrameCapturer::setJpegSnapshots(bool enabled) {
+    TRACE_CALL();
+    std::unique_lock<std::mutex> exclusion(captureLock);
+    snapshots.reset(enabled ? new HttpConnection(host, port, username, password) : 0);
+    poseKnown = false;
+}
+
+void FrameCapturer::setJpegScale(unsigned int scale) {
+    std::unique_lock<std::mutex> exclusion(captureLock);
+    jpegScale = scale;
+}
+
+FrameBuffer::Ptr FrameCapturer::grabFakeFrame(std::string filename) {
+    TRACE_CALL();
+    FrameBuffer::Ptr buffer = pool.acquire();
+    std::unique_lock<std::mutex> exclusion(captureLock);
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    jpeg.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    {
+        StageLatencies::Timer timer(&stageLatencies, StageLatencies::Conversion);
+        if (!decoder.decode(jpeg.data(), jpeg.size(), buffer->image, jpegScale))
+            LOG(ERROR) << "Error : cannot read " << filename;
+    }
+    buffer->time = FrameBuffer::now();
+    buffer->steady = true;
+    buffer->bgr = false;
+    buffer->calibration = calibration;
+    return buffer;
+}
+
 void FrameCapturer::init() {
-    LOG(INFO) << __PRETTY_FUNCTION__;
+    TRACE_CALL();
     LOG(INFO) << "Init axis connection...";
 
-    if(!axis.connect(username, password)){
+    if(!axis.connect(username, password) || !control.connect(username, password)){
         LOG(FATAL) << "Can't connect " << username
 	      << " (" << password << ") on "
 	      << host << ':' << port << ". Aborting.";
@@ -102,18 +363,7 @@ void FrameCapturer::init() {
 }
 
 void FrameCapturer::rgb2bgr(ImageRGB& img) {
-  ImageRGB::pixel_type pix,pix_end;
-
-  for(pix=img.begin(),pix_end=img.end();
-      pix!=pix_end;
-      ++pix)
-    rgb2bgr(*pix);
-}
-
-void FrameCapturer::rgb2bgr(ImageRGB::value_type& rgb) {
-  ImageRGB::value_type::value_type tmp;
-
-  tmp       = rgb._red;
-  rgb._red  = rgb._blue;
-  rgb._blue = tmp;
+    mirage::img::Coordinate size = img._dimension;
+    if (size[0] * size[1] > 0)
+        ColorFilter::swapRedBlue(imageBytes(img), size[0] * size[1]);
 }
@@ -1,14 +1,25 @@
 #ifndef FRAMECAPTURER_H
 #define FRAMECAPTURER_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <axisPTZ.h>
 #include <mirage.h>
+#include "FrameBuffer.h"
+#include "HttpConnection.h"
+#include "JpegDecoder.h"
+#include "LatencyHistogram.h"
+#include "MjpegStream.h"
+#include "SettleDetector.h"
 
 using namespace std;
 
-typedef mirage::img::Coding<mirage::colorspace::RGB_24>::Frame ImageRGB;
-
 class FrameCapturer
 {
     public:
@@ -17,29 +28,147 @@ class FrameCapturer
         ~FrameCapturer();
 
         void getPanTiltZoom(double &pan, double &tilt, double &zoom);
+        // Blocking moves : movePanTilt/moveZoom, waiting for the end.
         void setPanTilt(double &pan, double &tilt);
         void setZoom(double zoom);
+
+        // Moves without waiting. The moves are sent by a control thread,
+        // on a connection of their own, so that the captures go on during
+        // them. Only the latest goal is sent : a pan/tilt (or zoom) goal
+        // still waiting when another one is requested is dropped. The
+        // future is then false, and true once the camera reached the goal
+        // (and, for a zoom, once the image settled, see grabFrame).
+        std::future<bool> movePanTilt(double pan, double tilt);
+        std::future<bool> moveZoom(double zoom);
+        // Longest wait for the autofocus after a zoom change, 2000 ms by
+        // default : a zoom completes then even if no frame was grabbed.
+        // It also bounds the wait of grabFrame for a settled image, after
+        // any move and at startup.
+        void setZoomSettle(unsigned int milliseconds);
+        // A goal is waiting or being reached.
+        bool moving();
+
         string getHost(){return host;}
         int getPort(){return port;}
         string getUsername(){return username;}
         string getPassword(){return password;}
-        ImageRGB getFrame();
+        // Loaded from Calibration::directory when the capturer is created.
+        Calibration::Ptr getCalibration(){return calibration;}
+        // With swapChannels false, the frame is left in the camera BGR
+        // order so that the swap can be folded in a later pass
+        // (see FrameProcessor::filterColor).
+        ImageRGB getFrame(bool swapChannels = true);
         ImageRGB getFakeFrame(string filename);
 
+        // Pooled versions of getFrame/getFakeFrame : the frame is decoded
+        // once into a recycled buffer, which is then shared without copy.
+        // grabFrame also records the current pose, and leaves the pixels
+        // in the camera BGR order (see FrameBuffer::bgr). Its frames are
+        // not steady during a move and after it, until a SettleDetector
+        // finds that the sharpness of the image is stable, or at most
+        // until the zoom settle time (see setZoomSettle) has passed.
+        FrameBuffer::Ptr grabFrame();
+        FrameBuffer::Ptr grabFakeFrame(string filename);
+
+        // In streaming mode, grabFrame takes the latest frame of the MJPEG
+        // stream of the camera (at most fps frames per second, 0 for the
+        // camera default) instead of requesting an image for each frame,
+        // and no longer queries the pose but after a move. Its frames are
+        // then in RGB order. Off by default.
+        void setStreaming(bool enabled, unsigned int fps = 0);
+        // Out of streaming mode, grabFrame requests a JPEG snapshot
+        // (/axis-cgi/jpg/image.cgi) for each frame, on a connection kept
+        // open, instead of a bitmap several times larger. The pose is then
+        // handled as in streaming mode. Off by default.
+        void setJpegSnapshots(bool enabled);
+        // JPEG frames (streamed, snapshots and fake ones) are decoded at
+        // 1/scale of their resolution, scale being 1, 2, 4 or 8 (see
+        // JpegDecoder). The reprojection follows the image size, but the
+        // targets shrink as well. 1 by default.
+        void setJpegScale(unsigned int scale);
+
+        // Latencies of the stages of this camera : the capturer records
+        // the captures, conversions, pose queries and moves, and the
+        // processors bound to it (see FrameProcessor::setLatencies) the
+        // rest.
+        StageLatencies& latencies() { return stageLatencies; }
+
     protected:
     private:
         string host;
         int port;
         string username;
         string password;
+        Calibration::Ptr calibration;
 
+        // Captures and pose queries may come from different threads (see
+        // MultiCameraTracker). captureLock serializes the captures, and
+        // guards the state below but the moves, and axisLock the requests
+        // on axis. A capture takes axisLock after captureLock, and only
+        // once its JPEG frame is in. The moves use the control connection.
+        std::mutex captureLock;
+        std::mutex axisLock;
         axis::PTZ axis;
         ImageRGB frame;
         ImageRGB fakeFrame;
+        FramePool pool;
+
+        // Goals not sent yet, and their completions.
+        struct Goal {
+            bool panTilt;
+            double pan, tilt;
+            std::promise<bool> panTiltDone;
+            bool zoom;
+            double zoomValue;
+            std::promise<bool> zoomDone;
+        };
+
+        axis::PTZ control;
+        std::mutex controlLock;
+        std::condition_variable controlChanged;
+        Goal goal;
+        bool moveInProgress;
+        bool stopping;
+        unsigned int zoomSettle;
+        std::thread controlThread;
+
+        // Moves sent, the current one being under way if inMotion. The
+        // detector is reset by the first frame grabbed after each move,
+        // and settledMove is the last move the image settled after.
+        // settleStart is the last frame grabbed while moving, or the first
+        // one after the move, and settleTimedOut tells that the image was
+        // taken as settled because it did not settle in time.
+        // inMotion is set before moveGeneration is incremented, and read
+        // after it.
+        std::atomic<unsigned long> moveGeneration;
+        std::atomic<bool> inMotion;
+        SettleDetector settle;
+        unsigned long settleGeneration;
+        unsigned long settledMove;
+        std::chrono::steady_clock::time_point settleStart;
+        bool settleTimedOut;
+
+        // JPEG modes, see setStreaming and setJpegSnapshots. The pose is
+        // queried again when a move was sent since poseGeneration, or was
+        // under way then.
+        std::unique_ptr<MjpegStream> stream;
+        std::unique_ptr<HttpConnection> snapshots;
+        std::vector<unsigned char> jpeg;
+        JpegDecoder decoder;
+        unsigned int jpegScale;
+        double lastPan, lastTilt, lastZoom;
+        unsigned long poseGeneration;
+        bool poseKnown;
+
+        StageLatencies stageLatencies;
 
         void init();
+        void controlLoop();
+        // Waits for a JPEG frame, and decodes it into buffer.
+        bool readJpeg(FrameBuffer& buffer);
+        // Pose of a JPEG frame, under axisLock.
+        void readPose(FrameBuffer& buffer, bool moving, unsigned long generation);
         void rgb2bgr(ImageRGB& img);
-        void rgb2bgr(ImageRGB::value_type& rgb);
 };
 
 #endif // FRAMECAPTURER_H
@@ -1,61 +1,234 @@
 #include <math.h>
+#include <algorithm>
 #include <glog/logging.h>
 #include "FrameCapturer.h"
 #include "FrameProcessor.h"
+#include "ColorFilter.h"
+#include "Reprojection.h"
+#include "TraceLog.h"
 
 FrameProcessor::FrameProcessor(FrameCapturer& fc)
     //TODO
-    //:frameCapturer(&fc), frame_in(fc.getFakeFrame("fakeFrame.jpg")), pantiltsCentered()
-    :frameCapturer(&fc), frame_in(fc.getFrame()), pantiltsCentered()
+    //:frameCapturer(&fc), frame_in(fc.grabFakeFrame("fakeFrame.jpg")), pantiltsCentered()
+    :frameCapturer(&fc), latencies(&fc.latencies()), calibration(Calibration::standard()), frame_in(), mask(), pantiltsCentered(),
+     centersU(), centersV(), pansCentered(), tiltsCentered(),
+     roiEnabled(false), fullScanPeriod(15), roiMargin(24), framesSinceFullScan(0),
+     fullScanDue(true), scanningFull(true), targets(), windows(), scanned(0), frameBlobs(),
+     pyramidFactor(0), coarseMask(), coarseLabeller(-1)
 {
-    LOG(INFO) << __PRETTY_FUNCTION__;
-    frameCapturer->getPanTiltZoom(pan, tilt, zoom);
+    TRACE_CALL();
+    setFrame(frameCapturer->grabFrame());
+}
+
+FrameProcessor::FrameProcessor()
+    :frameCapturer(0), latencies(0), pan(0), tilt(0), zoom(0), calibration(Calibration::standard()),
+     frame_in(), mask(), pantiltsCentered(),
+     centersU(), centersV(), pansCentered(), tiltsCentered(),
+     roiEnabled(false), fullScanPeriod(15), roiMargin(24), framesSinceFullScan(0),
+     fullScanDue(true), scanningFull(true), targets(), windows(), scanned(0), frameBlobs(),
+     pyramidFactor(0), coarseMask(), coarseLabeller(-1)
+{
+    TRACE_CALL();
 }
 
 FrameProcessor::~FrameProcessor()
 {
-    LOG(INFO) << __PRETTY_FUNCTION__;
+    TRACE_CALL();
 }
 
 void FrameProcessor::nextFrame() {
-    LOG(INFO) << __PRETTY_FUNCTION__;
-    frameCapturer->getPanTiltZoom(pan, tilt, zoom);
-    frame_in = frameCapturer->getFrame();
+    TRACE_CALL();
+    setFrame(frameCapturer->grabFrame());
 }
 
 void FrameProcessor::nextFakeFrame(std::string filename) {
-    LOG(INFO) << __PRETTY_FUNCTION__;
-    //TODO Bug potential of frame buffer copy operation
-    frame_in = frameCapturer->getFakeFrame(filename);
+    TRACE_CALL();
+    frame_in = frameCapturer->grabFakeFrame(filename);
     //frameCapturer->getPanTiltZoom(pan, tilt, zoom);
 }
 
+void FrameProcessor::setFrame(FrameBuffer::Ptr frame) {
+    frame_in = frame;
+    pan = frame->pan;
+    tilt = frame->tilt;
+    zoom = frame->zoom;
+    calibration = frame->calibration ? frame->calibration : Calibration::standard();
+}
+
 void FrameProcessor::writeFrame(std::string filename) {
-    LOG(INFO) << __PRETTY_FUNCTION__;
-    mirage::img::JPEG::write(frame_in, filename, 70);
+    TRACE_CALL();
+    if (frame_in->bgr) {
+        StageLatencies::Timer timer(latencies, StageLatencies::Conversion);
+        mirage::img::Coordinate size = frame_in->image._dimension;
+        ColorFilter::swapRedBlue(imageBytes(frame_in->image), size[0] * size[1]);
+        frame_in->bgr = false;
+    }
+    mirage::img::JPEG::write(frame_in->image, filename, 70);
+}
+
+void FrameProcessor::writeMask(std::string filename) {
+    TRACE_CALL();
+    mirage::img::PPM::write(mask, filename);
+}
+
+void FrameProcessor::setRoiMode(bool enabled, unsigned int period, int margin) {
+    roiEnabled = enabled;
+    fullScanPeriod = period;
+    roiMargin = margin;
+    fullScanDue = true;
+}
+
+void FrameProcessor::setPyramidMode(unsigned int factor) {
+    pyramidFactor = factor > 1 ? factor : 0;
+}
+
+void FrameProcessor::setLatencies(StageLatencies* l) {
+    latencies = l;
+}
+
+// Overlapping or touching windows are merged, so that a blob is never
+// seen twice, even when it lies across their common edge.
+void FrameProcessor::mergeWindows() {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (std::size_t i = 0; i < windows.size() && !merged; ++i)
+            for (std::size_t j = i + 1; j < windows.size() && !merged; ++j) {
+                Window& a = windows[i];
+                const Window& b = windows[j];
+                if (a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1) {
+                    a.x0 = std::min(a.x0, b.x0);
+                    a.y0 = std::min(a.y0, b.y0);
+                    a.x1 = std::max(a.x1, b.x1);
+                    a.y1 = std::max(a.y1, b.y1);
+                    windows.erase(windows.begin() + j);
+                    merged = true;
+                }
+            }
+    }
+}
+
+// Windows around the targets projected in the current pose, or the whole
+// frame.
+void FrameProcessor::planWindows(int width, int height) {
+    windows.clear();
+    bool full = !roiEnabled || fullScanDue || targets.empty()
+        || framesSinceFullScan + 1 >= fullScanPeriod;
+
+    if (!full) {
+        Reprojection reprojection(pan, tilt, zoom, width/2, height/2, *calibration);
+        for (std::size_t i = 0; i < targets.size() && !full; ++i) {
+            const Target& target = targets[i];
+            double u, v;
+            if (!reprojection.toPixel(target.pan, target.tilt, u, v)) {
+                full = true;
+                break;
+            }
+            double scale = reprojection.focal() / target.focal;
+            double halfWidth = target.halfWidth * scale + roiMargin;
+            double halfHeight = target.halfHeight * scale + roiMargin;
+            Window w;
+            w.x0 = std::max(0, (int)floor(u - halfWidth));
+            w.y0 = std::max(0, (int)floor(v - halfHeight));
+            w.x1 = std::min(width, (int)ceil(u + halfWidth) + 1);
+            w.y1 = std::min(height, (int)ceil(v + halfHeight) + 1);
+            // Predicted out of the image : look for it everywhere.
+            if (w.x0 >= w.x1 || w.y0 >= w.y1)
+                full = true;
+            else
+                windows.push_back(w);
+        }
+        if (!full)
+            mergeWindows();
+    }
+
+    scanningFull = full;
+    if (full) {
+        Window w = { 0, 0, width, height };
+        windows.assign(1, w);
+        framesSinceFullScan = 0;
+        fullScanDue = false;
+    }
+    else
+        ++framesSinceFullScan;
+}
+
+// Windows around the blobs of the rows r * factor + factor / 2 : a blob
+// found on rows r0 to r1 does not reach rows r0 - 1 and r1 + 1, and a
+// convex one does not extend more than factor / 2 pixels horizontally
+// past its part in these rows (factor leaves a pixel of rounding). The
+// test is symmetric in red and blue, so a pending swap does not matter.
+void FrameProcessor::planCoarseWindows(int width, int height, int threshold) {
+    int f = pyramidFactor;
+    int rows = (height - f / 2 + f - 1) / f;
+    windows.clear();
+    if (rows <= 0)
+        return;
+
+    coarseMask.resize((std::size_t)width * rows);
+    unsigned char* pixels = imageBytes(frame_in->image);
+    for (int r = 0; r < rows; ++r)
+        ColorFilter::greenMask(pixels + 3 * (std::size_t)(r * f + f / 2) * width,
+                               &coarseMask[(std::size_t)r * width], 0, width, threshold);
+    scanned += (std::size_t)width * rows;
+
+    const std::vector<BlobLabeller::Blob>& found = coarseLabeller(&coarseMask[0], width, rows);
+    for (std::size_t i = 0; i < found.size(); ++i) {
+        const BlobLabeller::Blob& b = found[i];
+        Window w;
+        w.x0 = std::max(0, b.minX - f);
+        w.x1 = std::min(width, b.maxX + 1 + f);
+        w.y0 = std::max(0, (b.minY - 1) * f + f / 2 + 1);
+        w.y1 = std::min(height, (b.maxY + 1) * f + f / 2);
+        windows.push_back(w);
+    }
+    mergeWindows();
 }
 
+// Builds the binary mask read by the labeller. The frame is left
+// untouched, except for the pending red/blue swap which is done in the
+// same pass when the whole frame is scanned.
 void FrameProcessor::filterColor(int threshold) {
-    LOG(INFO) << __PRETTY_FUNCTION__;
+    TRACE_CALL();
+    StageLatencies::Timer timer(latencies, StageLatencies::Filter);
     try{
-        ImageRGB::pixel_type p,p_end;
-        ImageRGB::value_type black(0,0,0);
-        ImageRGB::value_type green(0,255,0);
-        for(p = frame_in.begin(), p_end = frame_in.end();
-            p != p_end;
-            ++p) {
-            ImageRGB::value_type& v = *p;
-
-            if (v._green > v._blue && v._green > v._red) {
-                int temp = v._blue < v._red ? v._blue : v._red;
-                if (v._green - temp > threshold)
-                    *p = green;
-                else
-                    *p = black;
+        ImageRGB& image = frame_in->image;
+        mirage::img::Coordinate size = image._dimension;
+        if (mask._dimension[0] != size[0] || mask._dimension[1] != size[1]) {
+            mask.resize(size);
+            fullScanDue = true;
+        }
+        windows.clear();
+        scanned = 0;
+        if (size[0] * size[1] == 0)
+            return;
+
+        planWindows(size[0], size[1]);
+        if (scanningFull && pyramidFactor)
+            planCoarseWindows(size[0], size[1], threshold);
+        unsigned char* pixels = imageBytes(image);
+        unsigned char* maskBytes = (unsigned char*)&(*mask.begin());
+        if (scanningFull && !pyramidFactor) {
+            ColorFilter::greenMask(pixels, maskBytes,
+                                   frame_in->bgr ? pixels : 0,
+                                   size[0] * size[1], threshold);
+            frame_in->bgr = false;
+            scanned = size[0] * size[1];
+            return;
+        }
+
+        // The mask does not depend on the channel order : a pending swap
+        // is left to writeFrame.
+        for (std::size_t i = 0; i < windows.size(); ++i) {
+            const Window& w = windows[i];
+            for (int y = w.y0; y < w.y1; ++y) {
+                std::size_t offset = (std::size_t)y * size[0] + w.x0;
+                ColorFilter::greenMask(pixels + 3 * offset, maskBytes + offset, 0,
+                                       w.x1 - w.x0, threshold);
             }
-            else
-                *p = black;
+            scanned += (w.x1 - w.x0) * (w.y1 - w.y0);
         }
+        TRACE_FRAME("Windows: {} Pixels: {}", windows.size(), scanned);
     }
     catch(mirage::Exception::Any& e) {
         LOG(ERROR) << "Error : " <<  e.what();
@@ -66,49 +239,83 @@ void FrameProcessor::filterColor(int threshold) {
 }
 
 std::vector<PanTiltCentered> FrameProcessor::findPositions() {
-    LOG(INFO) << __PRETTY_FUNCTION__;
+    TRACE_CALL();
     try {
-        labelizer.neighborhoodSurround(); // 8 neighbors considered
-        labelizer(frame_in);
-
-        mirage::img::Coordinate size = frame_in._dimension;
-        LOG(INFO) << "Nb_labels: " << labelizer.nb_labels;
-        LOG(INFO) << "Frame Width: " << size[0];
-        LOG(INFO) << "Frame Height: " << size[1];
-        double u0,v0,u,v,panCentered,tiltCentered;
-        u0 = size[0]/2;
-        v0 = size[1]/2;
-
         //greenPointCenters.clear();
         pantiltsCentered.clear();
+        centersU.clear();
+        centersV.clear();
 
-        for (unsigned int i = 1; i<= labelizer.nb_labels; ++i) {
-            const Labelizer::BoundingBox& box = labelizer.boundingBox(i);
-            mirage::img::Coordinate A,C;
+        mirage::img::Coordinate size = mask._dimension;
+        if (size[0] * size[1] == 0)
+            return pantiltsCentered;
 
-            A = box.min();
-            C = box.max();
+        // 8 neighbors considered
+        const unsigned char* maskBytes = (const unsigned char*)&(*mask.begin());
+        unsigned int nbComponents = 0;
+        frameBlobs.clear();
+        std::chrono::steady_clock::time_point labelling = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < windows.size(); ++i) {
+            const Window& w = windows[i];
+            const std::vector<BlobLabeller::Blob>& found =
+                labeller(maskBytes + (std::size_t)w.y0 * size[0] + w.x0,
+                         w.x1 - w.x0, w.y1 - w.y0, size[0]);
+            nbComponents += labeller.nbComponents();
+            for (std::size_t j = 0; j < found.size(); ++j) {
+                BlobLabeller::Blob blob = found[j];
+                blob.minX += w.x0;
+                blob.maxX += w.x0;
+                blob.cx += w.x0;
+                blob.minY += w.y0;
+                blob.maxY += w.y0;
+                blob.cy += w.y0;
+                frameBlobs.push_back(blob);
+            }
+        }
+        if (latencies)
+            latencies->record(StageLatencies::Labelling, labelling);
+        const std::vector<BlobLabeller::Blob>& blobs = frameBlobs;
+        TRACE_FRAME("Nb_labels: {} Frame Width: {} Frame Height: {}", nbComponents, size[0], size[1]);
+        double u0,v0;
+        u0 = size[0]/2;
+        v0 = size[1]/2;
 
-            if (C[0] - A[0] > 3 && C[1] - A[1] > 3) {
-                u = (A[0] + C[0]) / 2.0;
-                v = (A[1] + C[1]) / 2.0;
+        for (unsigned int i = 0; i < blobs.size(); ++i) {
+            centersU.push_back(blobs[i].boxCenterX());
+            centersV.push_back(blobs[i].boxCenterY());
 
-                //greenPointCenters.push_back(center);
+            TRACE_DETAIL("Blob: {} Area: {} Center_U: {} Center_V: {}",
+                         i, blobs[i].area, centersU.back(), centersV.back());
+        }
 
-                LOG(INFO) << "Label: " << i;
-                LOG(INFO) << "Center_U: " << u;
-                LOG(INFO) << "Center_V: " << v;
+        // All the centers of the frame at once, with the pose terms
+        // computed a single time.
+        std::size_t n = centersU.size();
+        pansCentered.resize(n);
+        tiltsCentered.resize(n);
+        Reprojection reprojection(pan, tilt, zoom, u0, v0, *calibration);
+        if (n > 0) {
+            StageLatencies::Timer timer(latencies, StageLatencies::Reprojection);
+            reprojection.toPanTilt(&centersU[0], &centersV[0], &pansCentered[0], &tiltsCentered[0], n);
+        }
 
-                //pan = 10.0132;
-                //tilt = -40.3937;
-                //zoom = 1998;
-                pantiltzoom(&panCentered,&tiltCentered,u,v,u0,v0,pan,tilt,zoom);
-                PanTiltCentered pantils(panCentered, tiltCentered);
-                pantiltsCentered.push_back(pantils);
-                LOG(INFO) << "PanCentered: " << panCentered;
-                LOG(INFO) << "TiltCentered: " << tiltCentered;
+        if (roiEnabled) {
+            // A target not found in its window may be anywhere.
+            if (!scanningFull && n < targets.size())
+                fullScanDue = true;
+            targets.resize(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                targets[i].pan = pansCentered[i];
+                targets[i].tilt = tiltsCentered[i];
+                targets[i].halfWidth = (blobs[i].maxX - blobs[i].minX) / 2.0;
+                targets[i].halfHeight = (blobs[i].maxY - blobs[i].minY) / 2.0;
+                targets[i].focal = reprojection.focal();
             }
         }
+        for (std::size_t i = 0; i < n; ++i) {
+            pantiltsCentered.push_back(PanTiltCentered(pansCentered[i], tiltsCentered[i]));
+            TRACE_DETAIL("PanCentered: {} TiltCentered: {}", pansCentered[i], tiltsCentered[i]);
+        }
     }
     catch(mirage::Exception::Any& e) {
         LOG(ERROR) << "Error : " <<  e.what();
@@ -119,27 +326,3 @@ std::vector<PanTiltCentered> FrameProcessor::findPositions() {
 
     return pantiltsCentered;
 }
-
-void FrameProcessor::pantiltzoom(double* ppan,double* ptilt,double u,double v,double u0,double v0,double pan0,double tilt0,double zoom)
-{
-	double focale,theta,alpha0,beta0,alpha,beta;
-	double x,y,z,X,Y,Z,norme;
-	theta=4.189301e+001-6.436043e-003*zoom+2.404497e-007*zoom*zoom;
-	focale=u0/tan((M_PI*theta/180.0)/2);
-
-	x=u-u0;y=v-v0;z=focale;
-	norme=sqrt(x*x+y*y+z*z);
-	x/=norme;y/=norme;z/=norme;
-
-	beta0=-(M_PI*pan0/180.0);
-	alpha0=-(M_PI*tilt0/180.0);
-
-	X=cos(beta0)*x+sin(alpha0)*sin(beta0)*y-cos(alpha0)*sin(beta0)*z;
-	Y=cos(alpha0)*y+sin(alpha0)*z;
-	Z=sin(beta0)*x-sin(alpha0)*cos(beta0)*y+cos(alpha0)*cos(beta0)*z;
-	alpha=atan2(Y,sqrt(X*X+Z*Z));
-	beta=-atan2(X,Z);
-
-	*ppan=-(180.0*beta/M_PI);
-	*ptilt=-(180.0*alpha/M_PI);
-}
@@ -3,42 +3,102 @@
 
 #include <string>
 #include <vector>
+#include "FrameBuffer.h"
+#include "BlobLabeller.h"
+#include "LatencyHistogram.h"
+#include "PanTiltCentered.h"
 
 class FrameCapturer;
 
 typedef std::pair<int, int> Center;
-typedef std::pair<double, double> PanTiltCentered;
+typedef mirage::img::Coding<mirage::colorspace::GRAY_8>::Frame ImageMask;
 
 class FrameProcessor
 {
-    struct Test {
-      bool operator()(const ImageRGB::value_type& rgb) {
-        return rgb._green > 127;
-      }
-    };
-
-    typedef mirage::algo::Labelizer<ImageRGB,Test,
-                                    mirage::algo::labelNone
-                                    | mirage::algo::labelPixelSet
-                                    | mirage::algo::labelBoundingBox> Labelizer;
-
     public:
         FrameProcessor(FrameCapturer& fc);
+        // Not bound to a camera : frames are given with setFrame.
+        FrameProcessor();
         ~FrameProcessor();
         void filterColor(int threshold);
         std::vector<PanTiltCentered> findPositions();
         void nextFrame();
         void nextFakeFrame(std::string filename);
+        // Takes a frame grabbed elsewhere. The buffer is shared, not
+        // copied, and may be modified in place (red/blue swap).
+        void setFrame(FrameBuffer::Ptr frame);
         void writeFrame(std::string filename);
+        void writeMask(std::string filename);
+
+        // Region of interest mode. Once targets are found, filterColor and
+        // findPositions only scan a window around the position predicted
+        // for each of them in the next frame, from their (pan, tilt) and
+        // the pose of that frame. The whole frame is scanned every
+        // fullScanPeriod frames, and as soon as a target is lost. Outside
+        // the windows, the mask keeps its previous content.
+        void setRoiMode(bool enabled, unsigned int fullScanPeriod = 15, int margin = 24);
+        // Coarse to fine mode. Instead of the whole frame, only one row out
+        // of factor is filtered and labelled, and the frame is then filtered
+        // at full resolution around the blobs of these rows only. Targets
+        // must be at least factor pixels high, and convex enough to extend
+        // at most factor pixels past their part in the rows filtered. 0 or
+        // 1 turns the mode off. Combined with the region of interest mode,
+        // it replaces its full frame scans.
+        void setPyramidMode(unsigned int factor);
+        // Pixels filtered for the last frame.
+        std::size_t pixelsScanned() const { return scanned; }
+        // Where the filter, labelling and reprojection latencies are
+        // recorded, nowhere if null. Those of the capturer by default.
+        void setLatencies(StageLatencies* latencies);
     protected:
     private:
+        // x1 and y1 excluded.
+        struct Window {
+            int x0, y0, x1, y1;
+        };
+
+        // Last known position of a target, and half size of its blob at
+        // the focal length it was seen with.
+        struct Target {
+            double pan, tilt;
+            double halfWidth, halfHeight;
+            double focal;
+        };
+
         FrameCapturer* frameCapturer;
+        StageLatencies* latencies;
         double pan, tilt, zoom;
-        ImageRGB frame_in;
-        Labelizer labelizer;
+        Calibration::Ptr calibration;
+        FrameBuffer::Ptr frame_in;
+        ImageMask mask;
+        // Drops the blobs not larger than 3 pixels in both directions.
+        BlobLabeller labeller;
         std::vector<PanTiltCentered> pantiltsCentered;
+        // Blob centers and their (pan, tilt), kept to reuse the storage.
+        std::vector<double> centersU, centersV;
+        std::vector<double> pansCentered, tiltsCentered;
+
+        bool roiEnabled;
+        unsigned int fullScanPeriod;
+        int roiMargin;
+        unsigned int framesSinceFullScan;
+        bool fullScanDue;
+        bool scanningFull;
+        std::vector<Target> targets;
+        std::vector<Window> windows;
+        std::size_t scanned;
+        // Blobs of all the windows, in frame coordinates.
+        std::vector<BlobLabeller::Blob> frameBlobs;
+
+        unsigned int pyramidFactor;
+        // Mask of the rows filtered by the coarse pass.
+        std::vector<unsigned char> coarseMask;
+        // Keeps the single pixels.
+        BlobLabeller coarseLabeller;
 
-        void pantiltzoom(double* ppan,double* ptilt,double u,double v,double u0,double v0,double pan0,double tilt0,double zoom);
+        void planWindows(int width, int height);
+        void planCoarseWindows(int width, int height, int threshold);
+        void mergeWindows();
 };
 
 #endif // FRAMEPROCESSOR_H
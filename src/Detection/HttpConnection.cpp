@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <glog/logging.h>
+#include "HttpConnection.h"
+
+namespace {
+
+// Past this, the answer is taken as garbage.
+const std::size_t maxBuffered = 16 << 20;
+
+std::string base64(const std::string& text) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string encoded;
+    for (std::size_t i = 0; i < text.size(); i += 3) {
+        unsigned int n = (unsigned char)text[i] << 16;
+        if (i + 1 < text.size()) n |= (unsigned char)text[i + 1] << 8;
+        if (i + 2 < text.size()) n |= (unsigned char)text[i + 2];
+        encoded += digits[(n >> 18) & 63];
+        encoded += digits[(n >> 12) & 63];
+        encoded += i + 1 < text.size() ? digits[(n >> 6) & 63] : '=';
+        encoded += i + 2 < text.size() ? digits[n & 63] : '=';
+    }
+    return encoded;
+}
+
+}
+
+HttpConnection::HttpConnection(const std::string& host, int port, const std::string& user,
+                               const std::string& password)
+    :host(host), port(port), credentials(authorization(user, password)), socket(-1), input()
+{
+}
+
+HttpConnection::~HttpConnection()
+{
+    close();
+}
+
+int HttpConnection::connect(const std::string& host, int port, unsigned int timeout) {
+    struct addrinfo hints, *addresses;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    std::ostringstream service;
+    service << port;
+    if (getaddrinfo(host.c_str(), service.str().c_str(), &hints, &addresses) != 0) {
+        LOG(ERROR) << "Error : cannot resolve " << host;
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo* address = addresses; address && fd < 0; address = address->ai_next) {
+        fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd >= 0 && ::connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0) {
+        LOG(ERROR) << "Error : cannot connect to " << host << ":" << port;
+        return -1;
+    }
+    struct timeval wait = {(time_t)timeout, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+    return fd;
+}
+
+std::string HttpConnection::authorization(const std::string& user, const std::string& password) {
+    return "Authorization: Basic " + base64(user + ":" + password) + "\r\n";
+}
+
+std::string HttpConnection::header(const std::string& headers, const std::string& name) {
+    std::string lower(headers);
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    std::size_t start = lower.find("\n" + name + ":");
+    if (start == std::string::npos)
+        return "";
+    start += name.size() + 2;
+    std::size_t end = headers.find_first_of("\r\n", start);
+    std::string value = headers.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    value.erase(0, value.find_first_not_of(" \t"));
+    return value;
+}
+
+bool HttpConnection::get(const std::string& path, std::vector<unsigned char>& body) {
+    bool retry = false;
+    if (request(path, body, retry))
+        return true;
+    // The camera may have closed the connection kept open since the last
+    // request.
+    return retry && request(path, body, retry);
+}
+
+bool HttpConnection::request(const std::string& path, std::vector<unsigned char>& body, bool& retry) {
+    bool reused = socket >= 0;
+    retry = false;
+    if (!reused) {
+        socket = connect(host, port, 5);
+        if (socket < 0)
+            return false;
+        input.clear();
+    }
+    std::string text = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\n" + credentials + "\r\n";
+    std::size_t end = std::string::npos;
+    bool sent = send(socket, text.data(), text.size(), MSG_NOSIGNAL) == (ssize_t)text.size();
+    while (sent && (end = input.find("\r\n\r\n")) == std::string::npos)
+        if (!fill())
+            break;
+    if (end == std::string::npos) {
+        retry = reused && input.empty();
+        if (!retry)
+            LOG(ERROR) << "Error : no answer from " << host << " to " << path;
+        close();
+        return false;
+    }
+
+    std::string headers = input.substr(0, end + 2);
+    std::size_t start = end + 4;
+    std::string status = headers.substr(0, headers.find("\r\n"));
+    if (status.compare(0, 5, "HTTP/") != 0 || status.find(" 200") == std::string::npos) {
+        // The body is not read : the connection is not reused.
+        LOG(ERROR) << "Error : " << host << " answered " << status << " to " << path;
+        close();
+        return false;
+    }
+    if (!header(headers, "transfer-encoding").empty()) {
+        LOG(ERROR) << "Error : unsupported transfer encoding from " << host;
+        close();
+        return false;
+    }
+
+    std::string length = header(headers, "content-length");
+    if (!length.empty()) {
+        std::size_t size = std::strtoul(length.c_str(), 0, 10);
+        while (input.size() < start + size)
+            if (!fill()) {
+                LOG(ERROR) << "Error : truncated answer from " << host << " to " << path;
+                close();
+                return false;
+            }
+        body.assign(input.begin() + start, input.begin() + start + size);
+        input.erase(0, start + size);
+        std::string connection = header(headers, "connection");
+        if (connection == "close" || connection == "Close")
+            close();
+    }
+    else {
+        // Delimited by the end of the connection.
+        while (fill())
+            ;
+        body.assign(input.begin() + start, input.end());
+        close();
+    }
+    return true;
+}
+
+bool HttpConnection::fill() {
+    if (input.size() > maxBuffered)
+        return false;
+    char chunk[64 * 1024];
+    ssize_t n = recv(socket, chunk, sizeof(chunk), 0);
+    if (n <= 0)
+        return false;
+    input.append(chunk, n);
+    return true;
+}
+
+void HttpConnection::close() {
+    if (socket >= 0)
+        ::close(socket);
+    socket = -1;
+    input.clear();
+}
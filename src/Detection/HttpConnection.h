@@ -0,0 +1,48 @@
+#ifndef HTTPCONNECTION_H
+#define HTTPCONNECTION_H
+
+#include <string>
+#include <vector>
+
+// Blocking HTTP/1.1 client for the CGIs of an Axis camera that the axisPTZ
+// library does not cover (JPEG images). The connection is kept open from
+// one request to the next, and opened again when the camera closed it.
+// Authentication is HTTP Basic only.
+class HttpConnection
+{
+    public:
+        HttpConnection(const std::string& host, int port, const std::string& user,
+                       const std::string& password);
+        ~HttpConnection();
+
+        // GET of path (with its query). Returns false, logging why, unless
+        // the answer is a 200 one, whose content is then in body.
+        bool get(const std::string& path, std::vector<unsigned char>& body);
+
+        // Socket connected to host:port, whose reads time out after timeout
+        // seconds, or -1.
+        static int connect(const std::string& host, int port, unsigned int timeout);
+        // Header line of the request.
+        static std::string authorization(const std::string& user, const std::string& password);
+        // Value of the header name (in lower case) in a header block, empty
+        // if absent.
+        static std::string header(const std::string& headers, const std::string& name);
+
+    protected:
+    private:
+        std::string host;
+        int port;
+        std::string credentials;
+        int socket;
+        // Received and not parsed yet.
+        std::string input;
+
+        bool request(const std::string& path, std::vector<unsigned char>& body, bool& retry);
+        bool fill();
+        void close();
+
+        HttpConnection(const HttpConnection&);
+        HttpConnection& operator=(const HttpConnection&);
+};
+
+#endif // HTTPCONNECTION_H
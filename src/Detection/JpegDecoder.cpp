@@ -0,0 +1,66 @@
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+#include <glog/logging.h>
+#include "JpegDecoder.h"
+
+// libjpeg reports errors through error_exit, which must not return : it
+// jumps back to decode.
+struct JpegDecoder::State {
+    jpeg_decompress_struct info;
+    jpeg_error_mgr errors;
+    std::jmp_buf onError;
+
+    static void fail(j_common_ptr info) {
+        char message[JMSG_LENGTH_MAX];
+        (*info->err->format_message)(info, message);
+        LOG(ERROR) << "JPEG : " << message;
+        std::longjmp(((State*)info->client_data)->onError, 1);
+    }
+
+    static void warn(j_common_ptr, int) {
+    }
+};
+
+JpegDecoder::JpegDecoder()
+    :state(new State())
+{
+    state->info.err = jpeg_std_error(&state->errors);
+    state->errors.error_exit = State::fail;
+    state->errors.emit_message = State::warn;
+    jpeg_create_decompress(&state->info);
+    state->info.client_data = state;
+}
+
+JpegDecoder::~JpegDecoder()
+{
+    jpeg_destroy_decompress(&state->info);
+    delete state;
+}
+
+bool JpegDecoder::decode(const unsigned char* data, std::size_t length, ImageRGB& image,
+                         unsigned int scale) {
+    jpeg_decompress_struct& info = state->info;
+    if (setjmp(state->onError)) {
+        jpeg_abort_decompress(&info);
+        return false;
+    }
+
+    jpeg_mem_src(&info, (unsigned char*)data, length);
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = JCS_RGB;
+    info.scale_num = 1;
+    info.scale_denom = scale > 1 ? scale : 1;
+    jpeg_start_decompress(&info);
+
+    mirage::img::Coordinate size(info.output_width, info.output_height);
+    if (image._dimension[0] != size[0] || image._dimension[1] != size[1])
+        image.resize(size);
+    unsigned char* pixels = imageBytes(image);
+    while (info.output_scanline < info.output_height) {
+        JSAMPROW row = pixels + 3 * (std::size_t)info.output_scanline * info.output_width;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_decompress(&info);
+    return true;
+}
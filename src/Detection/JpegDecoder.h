@@ -0,0 +1,34 @@
+#ifndef JPEGDECODER_H
+#define JPEGDECODER_H
+
+#include <cstddef>
+#include "FrameBuffer.h"
+
+// Decodes JPEG images held in memory (streamed or downloaded frames) with
+// libjpeg, straight into an ImageRGB whose allocation is reused when the
+// size does not change. The libjpeg state is kept from one frame to the
+// next.
+class JpegDecoder
+{
+    public:
+        JpegDecoder();
+        ~JpegDecoder();
+
+        // Pixels come out in RGB order. Returns false, the image being
+        // left in an unspecified state, if the data is not a JPEG image.
+        // With scale 2, 4 or 8, the image is reduced by that factor in the
+        // DCT domain, during the decoding : most of the inverse transform
+        // and of the color conversion is saved, not only the pixels.
+        bool decode(const unsigned char* data, std::size_t length, ImageRGB& image,
+                    unsigned int scale = 1);
+
+    protected:
+    private:
+        struct State;
+        State* state;
+
+        JpegDecoder(const JpegDecoder&);
+        JpegDecoder& operator=(const JpegDecoder&);
+};
+
+#endif // JPEGDECODER_H
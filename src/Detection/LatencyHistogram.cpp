@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cmath>
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram()
+    :counts(), maximum(0)
+{
+    reset();
+}
+
+// Values below SubBuckets have a bucket each. Above, the value is
+// (SubBuckets + m) << shift with m < SubBuckets, and its bucket is the
+// m-th of the range of shift.
+std::size_t LatencyHistogram::bucket(uint64_t nanoseconds) {
+    if (nanoseconds < SubBuckets)
+        return nanoseconds;
+    int shift = 63 - __builtin_clzll(nanoseconds) - SubBits;
+    if (shift > MaxShift)
+        return NbBuckets - 1;
+    return (shift + 1) * SubBuckets + (nanoseconds >> shift) - SubBuckets;
+}
+
+uint64_t LatencyHistogram::value(std::size_t bucket) {
+    if (bucket < SubBuckets)
+        return bucket;
+    int shift = bucket / SubBuckets - 1;
+    uint64_t lowest = (uint64_t)(bucket % SubBuckets + SubBuckets) << shift;
+    return lowest + ((uint64_t)1 << shift) / 2;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    counts[bucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t previous = maximum.load(std::memory_order_relaxed);
+    while (nanoseconds > previous
+           && !maximum.compare_exchange_weak(previous, nanoseconds, std::memory_order_relaxed))
+        ;
+}
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for (std::size_t i = 0; i < NbBuckets; ++i)
+        total += counts[i].load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    uint64_t total = count();
+    if (total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)std::ceil(q * total);
+    if (rank == 0)
+        rank = 1;
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < NbBuckets; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(value(i), max());
+    }
+    return max();
+}
+
+void LatencyHistogram::reset() {
+    for (std::size_t i = 0; i < NbBuckets; ++i)
+        counts[i].store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+const char* StageLatencies::name(Stage stage) {
+    static const char* names[NbStages] = {
+        "capture", "conversion", "filter", "labelling", "reprojection", "pose", "ptz"
+    };
+    return names[stage];
+}
+
+void StageLatencies::report(std::ostream& out, const std::string& prefix) const {
+    for (int s = 0; s < NbStages; ++s) {
+        const LatencyHistogram& h = histograms[s];
+        uint64_t n = h.count();
+        if (n == 0)
+            continue;
+        out << prefix << ' ' << name((Stage)s)
+            << " count: " << n
+            << " p50: " << h.percentile(0.5) / 1000.0
+            << " p99: " << h.percentile(0.99) / 1000.0
+            << " p999: " << h.percentile(0.999) / 1000.0
+            << " max: " << h.max() / 1000.0 << '\n';
+    }
+    out.flush();
+}
+
+void StageLatencies::reset() {
+    for (int s = 0; s < NbStages; ++s)
+        histograms[s].reset();
+}
@@ -0,0 +1,115 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <stdint.h>
+
+// Distribution of durations, in nanoseconds, with a relative precision of
+// 1/32 up to 2^41 ns (about 36 minutes, longer ones are counted there) :
+// each power of two is split into 32 buckets of the same width, as in an
+// HDR histogram.
+//
+// record only increments counters, without lock, and may be called from
+// several threads at once. The percentiles read the counters as they are,
+// which may be a few records behind the other threads.
+class LatencyHistogram
+{
+    public:
+        LatencyHistogram();
+
+        void record(uint64_t nanoseconds);
+
+        uint64_t count() const;
+        uint64_t max() const { return maximum.load(std::memory_order_relaxed); }
+        // Duration not exceeded by the fraction q (0.5, 0.99...) of the
+        // records, to the precision of the buckets. 0 without record.
+        uint64_t percentile(double q) const;
+        // Not atomic : records made meanwhile may be partly kept.
+        void reset();
+
+    protected:
+    private:
+        enum { SubBits = 5, SubBuckets = 1 << SubBits, MaxShift = 35,
+               NbBuckets = (MaxShift + 2) * SubBuckets };
+
+        std::atomic<uint64_t> counts[NbBuckets];
+        std::atomic<uint64_t> maximum;
+
+        static std::size_t bucket(uint64_t nanoseconds);
+        // Middle of the bucket.
+        static uint64_t value(std::size_t bucket);
+
+        LatencyHistogram(const LatencyHistogram&);
+        LatencyHistogram& operator=(const LatencyHistogram&);
+};
+
+// Latencies of the stages of the detection of one camera. The capturer
+// of the camera holds them (see FrameCapturer::latencies), and its
+// processor records there too.
+class StageLatencies
+{
+    public:
+        enum Stage {
+            Capture,        // FrameCapturer::grabFrame, as a whole
+            Conversion,     // JPEG decoding, or red/blue swap when it is
+                            // not folded into the filter
+            Filter,         // FrameProcessor::filterColor
+            Labelling,      // blob labelling of findPositions
+            Reprojection,   // pixel to (pan, tilt) of findPositions
+            Pose,           // pose queries to the camera
+            Ptz,            // moves, from the command to their end
+            NbStages
+        };
+
+        // Records the time elapsed since its creation into a stage, if
+        // latencies is not null.
+        class Timer {
+            public:
+                Timer(StageLatencies* latencies, Stage stage)
+                    :latencies(latencies), stage(stage),
+                     start(latencies ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+                {
+                }
+                ~Timer() {
+                    if (latencies)
+                        latencies->record(stage, start);
+                }
+
+            private:
+                StageLatencies* latencies;
+                Stage stage;
+                std::chrono::steady_clock::time_point start;
+
+                Timer(const Timer&);
+                Timer& operator=(const Timer&);
+        };
+
+        StageLatencies() {}
+
+        static const char* name(Stage stage);
+
+        LatencyHistogram& operator[](Stage stage) { return histograms[stage]; }
+        void record(Stage stage, std::chrono::steady_clock::time_point start) {
+            histograms[stage].record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+
+        // One line per stage recorded :
+        //     <prefix> <stage> count: <n> p50: <us> p99: <us> p999: <us> max: <us>
+        // the durations in microseconds.
+        void report(std::ostream& out, const std::string& prefix) const;
+        void reset();
+
+    protected:
+    private:
+        LatencyHistogram histograms[NbStages];
+
+        StageLatencies(const StageLatencies&);
+        StageLatencies& operator=(const StageLatencies&);
+};
+
+#endif // LATENCYHISTOGRAM_H
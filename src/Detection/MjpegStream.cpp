@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <glog/logging.h>
+#include "HttpConnection.h"
+#include "MjpegStream.h"
+
+namespace {
+
+// Past this, the stream is taken as garbage and the connection reopened.
+const std::size_t maxBuffered = 16 << 20;
+
+}
+
+MjpegStream::MjpegStream(const std::string& host, int port, const std::string& user,
+                         const std::string& password, unsigned int fps)
+    :host(host), port(port), request(), lock(), arrived(), ready(), fresh(false), back(), input(),
+     running(false), socket(-1), reader(), nbReceived(0), nbSkipped(0)
+{
+    std::ostringstream text;
+    text << "GET /axis-cgi/mjpg/video.cgi";
+    if (fps > 0)
+        text << "?fps=" << fps;
+    text << " HTTP/1.0\r\n"
+         << "Host: " << host << "\r\n"
+         << HttpConnection::authorization(user, password) << "\r\n";
+    request = text.str();
+}
+
+MjpegStream::~MjpegStream()
+{
+    stop();
+}
+
+void MjpegStream::start() {
+    if (running)
+        return;
+    running = true;
+    reader = std::thread(&MjpegStream::run, this);
+}
+
+void MjpegStream::stop() {
+    running = false;
+    {
+        // Wakes the reader up from recv.
+        std::unique_lock<std::mutex> exclusion(lock);
+        if (socket >= 0)
+            shutdown(socket, SHUT_RDWR);
+        arrived.notify_all();
+    }
+    if (reader.joinable())
+        reader.join();
+}
+
+bool MjpegStream::next(std::vector<unsigned char>& jpeg, unsigned int timeout) {
+    std::unique_lock<std::mutex> exclusion(lock);
+    arrived.wait_for(exclusion, std::chrono::milliseconds(timeout),
+                     [this]{ return fresh || !running; });
+    if (!fresh)
+        return false;
+    jpeg.swap(ready);
+    fresh = false;
+    return true;
+}
+
+void MjpegStream::run() {
+    while (running) {
+        int fd = open();
+        if (fd >= 0) {
+            read(fd);
+            close();
+        }
+        if (running) {
+            LOG(WARNING) << "Stream of " << host << ":" << port << " lost, reconnecting";
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+    }
+}
+
+int MjpegStream::open() {
+    // A camera which stops sending is treated as a lost connection.
+    int fd = HttpConnection::connect(host, port, 5);
+    if (fd < 0)
+        return -1;
+    {
+        std::unique_lock<std::mutex> exclusion(lock);
+        if (!running) {
+            ::close(fd);
+            return -1;
+        }
+        socket = fd;
+    }
+    if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size()) {
+        LOG(ERROR) << "Error : cannot send the stream request to " << host;
+        close();
+        return -1;
+    }
+    return fd;
+}
+
+void MjpegStream::close() {
+    std::unique_lock<std::mutex> exclusion(lock);
+    if (socket >= 0)
+        ::close(socket);
+    socket = -1;
+}
+
+bool MjpegStream::fill(int fd) {
+    if (input.size() > maxBuffered)
+        return false;
+    char chunk[64 * 1024];
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0)
+        return false;
+    input.append(chunk, n);
+    return true;
+}
+
+bool MjpegStream::find(int fd, const std::string& pattern, std::size_t from, std::size_t& position) {
+    for (;;) {
+        position = input.find(pattern, from);
+        if (position != std::string::npos)
+            return true;
+        if (input.size() > from + pattern.size())
+            from = input.size() - pattern.size();
+        if (!running || !fill(fd))
+            return false;
+    }
+}
+
+void MjpegStream::read(int fd) {
+    input.clear();
+    std::size_t end;
+    if (!find(fd, "\r\n\r\n", 0, end))
+        return;
+    std::string headers = input.substr(0, end + 2);
+    if (headers.compare(0, 5, "HTTP/") != 0 || headers.find(" 200") > headers.find("\r\n")) {
+        LOG(ERROR) << "Error : stream refused by " << host << " : " << headers.substr(0, headers.find("\r\n"));
+        return;
+    }
+    std::string type = HttpConnection::header(headers, "content-type");
+    std::size_t start = type.find("boundary=");
+    if (start == std::string::npos) {
+        LOG(ERROR) << "Error : no multipart boundary in the stream of " << host;
+        return;
+    }
+    // The parts are delimited by "--boundary", which some cameras already
+    // put in the header : searching for the bare name finds both.
+    std::string boundary = type.substr(start + 9, type.find(';', start) - start - 9);
+    boundary.erase(std::remove(boundary.begin(), boundary.end(), '"'), boundary.end());
+    boundary.erase(0, boundary.find_first_not_of('-'));
+    input.erase(0, end + 4);
+
+    while (running) {
+        std::size_t delimiter, body;
+        if (!find(fd, boundary, 0, delimiter) || !find(fd, "\r\n\r\n", delimiter, body))
+            return;
+        body += 4;
+        std::string length = HttpConnection::header(input.substr(delimiter, body - delimiter), "content-length");
+        std::size_t size;
+        if (!length.empty()) {
+            // Only the start of the body read along with the part header
+            // is copied, the rest is received straight into back.
+            size = std::strtoul(length.c_str(), 0, 10);
+            if (size > maxBuffered)
+                return;
+            std::size_t copied = std::min(input.size() - body, size);
+            back.resize(size);
+            std::copy(input.begin() + body, input.begin() + body + copied, back.begin());
+            input.erase(0, body + copied);
+            while (copied < size) {
+                if (!running)
+                    return;
+                ssize_t n = recv(fd, &back[copied], size - copied, 0);
+                if (n <= 0)
+                    return;
+                copied += n;
+            }
+        }
+        else {
+            // Up to the next delimiter, less the line break before it.
+            std::size_t following;
+            if (!find(fd, boundary, body, following))
+                return;
+            size = input.rfind("\r\n", following) - body;
+            if (size > following - body)
+                size = following - body;
+            back.assign(input.begin() + body, input.begin() + body + size);
+            input.erase(0, body + size);
+        }
+        publish();
+    }
+}
+
+void MjpegStream::publish() {
+    std::unique_lock<std::mutex> exclusion(lock);
+    ready.swap(back);
+    if (fresh)
+        ++nbSkipped;
+    fresh = true;
+    ++nbReceived;
+    arrived.notify_all();
+}
@@ -0,0 +1,78 @@
+#ifndef MJPEGSTREAM_H
+#define MJPEGSTREAM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Client of the multipart JPEG stream of an Axis camera
+// (/axis-cgi/mjpg/video.cgi) : one HTTP connection, kept open, over which
+// the camera pushes its frames at its own rate.
+//
+// A reader thread splits the stream into JPEG images as the bytes come
+// in, and keeps the latest one only : a frame not taken before the next
+// one is complete is replaced (triple buffering : the reader fills its
+// own buffer, swaps it with the ready one, and next swaps the ready one
+// with the buffer of the caller, so that images are not copied from a
+// thread to another). When a part gives its Content-Length, its body is
+// received straight into the reader's buffer, but for the bytes read
+// along with its header. Otherwise it is copied out of the input once
+// the next delimiter is found. The connection is opened again after an
+// error.
+class MjpegStream
+{
+    public:
+        // fps = 0 leaves the rate to the camera.
+        MjpegStream(const std::string& host, int port, const std::string& user,
+                    const std::string& password, unsigned int fps = 0);
+        ~MjpegStream();
+
+        void start();
+        void stop();
+
+        // Waits at most timeout milliseconds for a frame newer than the
+        // last one taken, and swaps its bytes into jpeg.
+        bool next(std::vector<unsigned char>& jpeg, unsigned int timeout);
+
+        // Frames completed by the reader, and those replaced before being
+        // taken.
+        unsigned long received() const { return nbReceived; }
+        unsigned long skipped() const { return nbSkipped; }
+
+    protected:
+    private:
+        std::string host;
+        int port;
+        // HTTP request sent on each connection.
+        std::string request;
+
+        std::mutex lock;
+        std::condition_variable arrived;
+        std::vector<unsigned char> ready;
+        bool fresh;
+        // Used by the reader only : the frame being received, and the bytes
+        // read and not parsed yet.
+        std::vector<unsigned char> back;
+        std::string input;
+
+        std::atomic<bool> running;
+        int socket;                     // under lock, -1 when closed
+        std::thread reader;
+        std::atomic<unsigned long> nbReceived, nbSkipped;
+
+        void run();
+        int open();
+        void close();
+        bool fill(int fd);
+        bool find(int fd, const std::string& pattern, std::size_t from, std::size_t& position);
+        void read(int fd);
+        void publish();
+
+        MjpegStream(const MjpegStream&);
+        MjpegStream& operator=(const MjpegStream&);
+};
+
+#endif // MJPEGSTREAM_H
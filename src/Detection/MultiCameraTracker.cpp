@@ -0,0 +1,173 @@
+#include <chrono>
+#include <thread>
+#include <glog/logging.h>
+#include "FrameCapturer.h"
+#include "MultiCameraTracker.h"
+
+MultiCameraTracker::MultiCameraTracker(int threshold, Publisher publisher, unsigned int nbWorkers)
+    :threshold(threshold), roiEnabled(false), roiFullScanPeriod(15), roiMargin(24), pyramidFactor(0),
+     publisher(publisher), publishLock(), cameras(),
+     running(false), runLock(), stopped(), nbCaptured(0), nbProcessed(0), nbDropped(0), nbUnsteady(0),
+     flightLock(), landed(), inFlight(0), workers(nbWorkers)
+{
+    LOG(INFO) << __PRETTY_FUNCTION__;
+    LOG(INFO) << "Workers: " << workers.size();
+}
+
+MultiCameraTracker::~MultiCameraTracker()
+{
+    LOG(INFO) << __PRETTY_FUNCTION__;
+    stop();
+}
+
+unsigned int MultiCameraTracker::addCamera(std::string host, int port, std::string user, std::string password) {
+    LOG(INFO) << __PRETTY_FUNCTION__;
+    Camera* camera = new Camera();
+    camera->index = cameras.size();
+    camera->capturer.reset(new FrameCapturer(host, port, user, password));
+    camera->processing = false;
+    camera->processor.setLatencies(&camera->capturer->latencies());
+    camera->processor.setRoiMode(roiEnabled, roiFullScanPeriod, roiMargin);
+    camera->processor.setPyramidMode(pyramidFactor);
+    cameras.push_back(std::unique_ptr<Camera>(camera));
+    return camera->index;
+}
+
+void MultiCameraTracker::setRoiMode(bool enabled, unsigned int fullScanPeriod, int margin) {
+    roiEnabled = enabled;
+    roiFullScanPeriod = fullScanPeriod;
+    roiMargin = margin;
+    for (unsigned int i = 0; i < cameras.size(); ++i)
+        cameras[i]->processor.setRoiMode(enabled, fullScanPeriod, margin);
+}
+
+void MultiCameraTracker::setPyramidMode(unsigned int factor) {
+    pyramidFactor = factor;
+    for (unsigned int i = 0; i < cameras.size(); ++i)
+        cameras[i]->processor.setPyramidMode(factor);
+}
+
+void MultiCameraTracker::start() {
+    LOG(INFO) << __PRETTY_FUNCTION__;
+    running = true;
+    for (unsigned int i = 0; i < cameras.size(); ++i)
+        cameras[i]->captureThread = std::thread(&MultiCameraTracker::captureLoop, this, cameras[i].get());
+}
+
+void MultiCameraTracker::stop() {
+    {
+        std::unique_lock<std::mutex> exclusion(runLock);
+        running = false;
+        stopped.notify_all();
+    }
+    for (unsigned int i = 0; i < cameras.size(); ++i)
+        if (cameras[i]->captureThread.joinable())
+            cameras[i]->captureThread.join();
+    std::unique_lock<std::mutex> exclusion(flightLock);
+    while (inFlight > 0)
+        landed.wait(exclusion);
+}
+
+void MultiCameraTracker::schedule(std::function<void ()> task) {
+    {
+        std::unique_lock<std::mutex> exclusion(flightLock);
+        ++inFlight;
+    }
+    workers.submit([this, task]() {
+        try {
+            task();
+        }
+        catch(std::exception& e) {
+            LOG(ERROR) << "Error : " <<  e.what();
+        }
+        std::unique_lock<std::mutex> exclusion(flightLock);
+        if (--inFlight == 0)
+            landed.notify_all();
+    });
+}
+
+void MultiCameraTracker::captureLoop(Camera* camera) {
+    while (running) {
+        FrameBuffer::Ptr frame;
+        try {
+            frame = camera->capturer->grabFrame();
+        }
+        catch(mirage::Exception::Any& e) {
+            LOG(ERROR) << "Error : " <<  e.what();
+        }
+        catch(...) {
+            LOG(ERROR) << "Unknown error";
+        }
+
+        if (frame && !frame->steady) {
+            ++nbCaptured;
+            ++nbUnsteady;
+        }
+        else if (frame) {
+            ++nbCaptured;
+            std::unique_lock<std::mutex> exclusion(camera->lock);
+            if (camera->processing) {
+                if (camera->pending)
+                    ++nbDropped;
+                camera->pending = frame;
+            }
+            else {
+                camera->processing = true;
+                schedule(std::bind(&MultiCameraTracker::process, this, camera, frame));
+            }
+        }
+        else {
+            // Camera unreachable, wait a bit before retrying, unless
+            // stopped meanwhile.
+            std::unique_lock<std::mutex> exclusion(runLock);
+            stopped.wait_for(exclusion, std::chrono::milliseconds(500), [this]() { return !running; });
+        }
+    }
+}
+
+void MultiCameraTracker::process(Camera* camera, FrameBuffer::Ptr frame) {
+    Detections d;
+    d.camera = camera->index;
+    d.sequence = frame->sequence;
+    d.time = frame->time;
+    d.pan = frame->pan;
+    d.tilt = frame->tilt;
+    d.zoom = frame->zoom;
+
+    // A frame which fails is dropped, the hand-off below must run anyway
+    // or the camera would never be processed again.
+    try {
+        camera->processor.setFrame(frame);
+        frame.reset();
+        camera->processor.filterColor(threshold);
+        d.positions = camera->processor.findPositions();
+        camera->tracker.update(d.positions, d.time);
+        d.ids = camera->tracker.ids();
+        ++nbProcessed;
+
+        std::unique_lock<std::mutex> exclusion(publishLock);
+        publisher(d);
+    }
+    catch(mirage::Exception::Any& e) {
+        LOG(ERROR) << "Error : camera " << camera->index << " : " <<  e.what();
+    }
+    catch(std::exception& e) {
+        LOG(ERROR) << "Error : camera " << camera->index << " : " <<  e.what();
+    }
+    catch(...) {
+        LOG(ERROR) << "Unknown error, camera " << camera->index;
+    }
+
+    // Next frame of this camera, if one came in meanwhile. It goes back to
+    // the pool queue, behind the other cameras.
+    std::unique_lock<std::mutex> exclusion(camera->lock);
+    if (camera->pending && running) {
+        FrameBuffer::Ptr next = camera->pending;
+        camera->pending.reset();
+        schedule(std::bind(&MultiCameraTracker::process, this, camera, next));
+    }
+    else {
+        camera->pending.reset();
+        camera->processing = false;
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef MULTICAMERATRACKER_H
+#define MULTICAMERATRACKER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameBuffer.h"
+#include "FrameProcessor.h"
+#include "DetectionPipeline.h"
+#include "TargetTracker.h"
+#include "WorkerPool.h"
+
+class FrameCapturer;
+
+// Drives several cameras from one process. Each camera is captured by a
+// thread of its own, which spends its time waiting on the network, and
+// the frames of all the cameras are processed by tasks scheduled on one
+// WorkerPool, sized for the computation. A slow or unreachable camera
+// thus never holds a worker. The detections of all the cameras are
+// merged into one stream (the publisher is never called concurrently).
+//
+// A camera has at most one processing in flight. A frame captured while
+// the previous one is still processed waits in a one frame slot, and
+// replaces the frame already waiting there, if any.
+class MultiCameraTracker
+{
+    public:
+        typedef std::function<void (const Detections&)> Publisher;
+
+        // nbWorkers = 0 means one worker per core.
+        MultiCameraTracker(int threshold, Publisher publisher, unsigned int nbWorkers = 0);
+        ~MultiCameraTracker();
+
+        // Returns the camera index, reported in Detections::camera.
+        unsigned int addCamera(std::string host, int port, std::string user, std::string password);
+        FrameCapturer& camera(unsigned int index) { return *cameras[index]->capturer; }
+        unsigned int nbCameras() const { return cameras.size(); }
+
+        // See FrameProcessor::setRoiMode. To be called before start.
+        void setRoiMode(bool enabled, unsigned int fullScanPeriod = 15, int margin = 24);
+        // See FrameProcessor::setPyramidMode. To be called before start.
+        void setPyramidMode(unsigned int factor);
+
+        void start();
+        // Stops the captures and waits for the tasks in flight.
+        void stop();
+
+        unsigned long captured() const { return nbCaptured; }
+        unsigned long processed() const { return nbProcessed; }
+        unsigned long dropped() const { return nbDropped; }
+        // See DetectionPipeline::unsteady.
+        unsigned long unsteady() const { return nbUnsteady; }
+
+    protected:
+    private:
+        struct Camera {
+            unsigned int index;
+            std::unique_ptr<FrameCapturer> capturer;
+            FrameProcessor processor;
+            TargetTracker tracker;
+            std::mutex lock;
+            FrameBuffer::Ptr pending;
+            bool processing;
+            std::thread captureThread;
+        };
+
+        int threshold;
+        bool roiEnabled;
+        unsigned int roiFullScanPeriod;
+        int roiMargin;
+        unsigned int pyramidFactor;
+        Publisher publisher;
+        std::mutex publishLock;
+        std::vector<std::unique_ptr<Camera> > cameras;
+
+        std::atomic<bool> running;
+        // Wakes the capture threads waiting before a retry.
+        std::mutex runLock;
+        std::condition_variable stopped;
+        std::atomic<unsigned long> nbCaptured, nbProcessed, nbDropped, nbUnsteady;
+        std::mutex flightLock;
+        std::condition_variable landed;
+        unsigned int inFlight;
+
+        // Last member : its destructor joins the workers first.
+        WorkerPool workers;
+
+        void schedule(std::function<void ()> task);
+        void captureLoop(Camera* camera);
+        void process(Camera* camera, FrameBuffer::Ptr frame);
+};
+
+#endif // MULTICAMERATRACKER_H
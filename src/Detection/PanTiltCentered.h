@@ -0,0 +1,10 @@
+#ifndef PANTILTCENTERED_H
+#define PANTILTCENTERED_H
+
+#include <utility>
+
+// (pan, tilt) in degrees of the camera centered on a target, as found by
+// FrameProcessor::findPositions and followed by TargetTracker.
+typedef std::pair<double, double> PanTiltCentered;
+
+#endif // PANTILTCENTERED_H
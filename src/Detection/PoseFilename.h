@@ -0,0 +1,24 @@
+#ifndef POSEFILENAME_H
+#define POSEFILENAME_H
+
+#include <cstdio>
+#include <string>
+
+// Pose encoded by PlayGround/camera.cpp in the name of the frames it saves :
+//     X_<x>Y_<y>pan_<pan>tilt_<tilt>zoom_<zoom>.jpg
+// (x, y) is the position of the target on the floor grid.
+struct FramePose {
+    double x, y;
+    double pan, tilt, zoom;
+};
+
+// Returns false if the file name (directories are ignored) does not
+// follow this pattern.
+inline bool parsePoseFilename(const std::string& path, FramePose& pose) {
+    std::string::size_type slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    return std::sscanf(name.c_str(), "X_%lfY_%lfpan_%lftilt_%lfzoom_%lf",
+                       &pose.x, &pose.y, &pose.pan, &pose.tilt, &pose.zoom) == 5;
+}
+
+#endif // POSEFILENAME_H
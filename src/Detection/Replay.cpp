@@ -0,0 +1,137 @@
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <glog/logging.h>
+#include "DetectionPipeline.h"
+#include "ReplaySource.h"
+#include "TraceLog.h"
+
+// Runs the detection on recorded frames, without any camera : each
+// directory given on the command line (see ReplaySource) is replayed
+// through a DetectionPipeline of its own, all of them at once. The
+// detections are written on stdout in the format of TrackingDaemon, the
+// index of the directory standing for the camera :
+//     <directory> <frame> <pan> <tilt> <zoom> <nb targets> [<id> <pan> <tilt>]...
+// and the throughput on stderr at the end, followed by the latencies of
+// the processing stages of each directory (see StageLatencies).
+//
+// No frame is dropped, whatever the speed : the output only depends on
+// the frames, which makes it suitable to compare versions of the
+// detection, and to measure its throughput.
+
+void loggerInit(char* argv0) {
+    google::InitGoogleLogging(argv0);
+    FLAGS_logtostderr = 1;
+    FLAGS_minloglevel = 1;
+    TraceLog::start();
+}
+
+int main(int argc, char* argv[]) {
+    char* program = argv[0];
+    bool roi = false;
+    unsigned int pyramid = 0;
+    double speed = 0;
+    unsigned int nbDecoders = 0;
+    unsigned int scale = 1;
+    while (argc > 1 && argv[1][0] == '-') {
+        std::string option(argv[1]);
+        if (option == "-r")
+            roi = true;
+        else if (option == "-p" && argc > 2) {
+            pyramid = atoi(argv[2]);
+            --argc;
+            ++argv;
+        }
+        else if (option == "-t" && argc > 2) {
+            speed = atof(argv[2]);
+            --argc;
+            ++argv;
+        }
+        else if (option == "-d" && argc > 2) {
+            nbDecoders = atoi(argv[2]);
+            --argc;
+            ++argv;
+        }
+        else if (option == "-j" && argc > 2) {
+            scale = atoi(argv[2]);
+            --argc;
+            ++argv;
+        }
+        else
+            break;
+        --argc;
+        ++argv;
+    }
+    argv[0] = program;
+    if (argc < 3) {
+        std::cerr << "Usage : " << argv[0]
+                  << " [-r] [-p <factor>] [-t <speed>] [-d <decoders>] [-j <scale>] <threshold> <directory>..." << std::endl
+                  << "  -r, -p : see TrackingDaemon" << std::endl
+                  << "  -t : replay at speed times the recorded pace (0, default : as fast as possible)" << std::endl
+                  << "  -d : decoding threads per directory (0, default : cores / directories)" << std::endl
+                  << "  -j : decode the frames at 1/scale of their size (1, 2, 4 or 8)" << std::endl
+                  << "ex : " << argv[0] << " 35 PlayGround/images" << std::endl;
+        return 1;
+    }
+    loggerInit(argv[0]);
+
+    int threshold = atoi(argv[1]);
+    unsigned int nbDirectories = argc - 2;
+    if (nbDecoders == 0)
+        nbDecoders = std::max(1u, std::thread::hardware_concurrency() / nbDirectories);
+
+    std::mutex outputLock;
+    std::vector<std::unique_ptr<ReplaySource> > sources;
+    std::vector<std::unique_ptr<DetectionPipeline> > pipelines;
+    std::vector<std::unique_ptr<StageLatencies> > latencies;
+    for (unsigned int i = 0; i < nbDirectories; ++i) {
+        ReplaySource* source = new ReplaySource(argv[i + 2], nbDecoders, 8, scale);
+        source->setSpeed(speed);
+        sources.push_back(std::unique_ptr<ReplaySource>(source));
+        DetectionPipeline* pipeline = new DetectionPipeline(
+            std::bind(&ReplaySource::next, source), threshold,
+            [i, &outputLock](const Detections& d) {
+                std::unique_lock<std::mutex> exclusion(outputLock);
+                std::cout << i << ' ' << d.sequence << ' '
+                          << d.pan << ' ' << d.tilt << ' ' << d.zoom << ' '
+                          << d.positions.size();
+                for (unsigned int j = 0; j < d.positions.size(); ++j)
+                    std::cout << ' ' << d.ids[j] << ' ' << d.positions[j].first << ' ' << d.positions[j].second;
+                std::cout << '\n';
+            },
+            2, BoundedQueueBase::Block);
+        pipeline->setRoiMode(roi);
+        pipeline->setPyramidMode(pyramid);
+        latencies.push_back(std::unique_ptr<StageLatencies>(new StageLatencies()));
+        pipeline->setLatencies(latencies.back().get());
+        pipelines.push_back(std::unique_ptr<DetectionPipeline>(pipeline));
+    }
+
+    double start = FrameBuffer::now();
+    for (unsigned int i = 0; i < nbDirectories; ++i)
+        pipelines[i]->start();
+    unsigned long nbProcessed = 0;
+    for (unsigned int i = 0; i < nbDirectories; ++i) {
+        pipelines[i]->join();
+        nbProcessed += pipelines[i]->processed();
+    }
+    double seconds = FrameBuffer::now() - start;
+    std::cout.flush();
+
+    std::cerr << "processed: " << nbProcessed
+              << " seconds: " << seconds
+              << " fps: " << (seconds > 0 ? nbProcessed / seconds : 0) << std::endl;
+    for (unsigned int i = 0; i < nbDirectories; ++i) {
+        std::ostringstream prefix;
+        prefix << "latency directory: " << i << " stage:";
+        latencies[i]->report(std::cerr, prefix.str());
+    }
+    return 0;
+}
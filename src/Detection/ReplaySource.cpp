@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <glog/logging.h>
+#include "JpegDecoder.h"
+#include "ReplaySource.h"
+
+namespace {
+
+struct RecordedBefore {
+    template<typename File>
+    bool operator()(const File& a, const File& b) const {
+        return a.time < b.time || (a.time == b.time && a.path < b.path);
+    }
+};
+
+bool readFile(const std::string& path, std::vector<unsigned char>& bytes) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    bytes.resize(size > 0 ? size : 0);
+    bool read = size > 0 && std::fread(&bytes[0], 1, size, file) == (std::size_t)size;
+    std::fclose(file);
+    return read;
+}
+
+}
+
+ReplaySource::ReplaySource(const std::string& directory, unsigned int nbDecoders,
+                           unsigned int readAhead, unsigned int scale)
+    :files(), archive(), fromArchive(false), scale(scale), speed(0), calibration(), pool(readAhead + 2),
+     lock(), changed(), slots(readAhead > 0 ? readAhead : 1), claimed(0), delivered(0),
+     stopping(false), start(0), decoders()
+{
+    LOG(INFO) << __PRETTY_FUNCTION__;
+    struct stat status;
+    fromArchive = stat(directory.c_str(), &status) == 0 && S_ISREG(status.st_mode);
+    if (fromArchive && archive.open(directory)) {
+        files.resize(archive.size());
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            const ArchiveRecord& record = archive.record(i);
+            files[i].path.assign(record.name, strnlen(record.name, sizeof(record.name)));
+            files[i].pose.x = record.x;
+            files[i].pose.y = record.y;
+            files[i].pose.pan = record.pan;
+            files[i].pose.tilt = record.tilt;
+            files[i].pose.zoom = record.zoom;
+            files[i].time = record.time;
+        }
+    }
+    DIR* dir = fromArchive ? 0 : opendir(directory.c_str());
+    if (!dir && !fromArchive)
+        LOG(ERROR) << "Error : cannot open " << directory;
+    while (dir) {
+        struct dirent* entry = readdir(dir);
+        if (!entry)
+            break;
+        File file;
+        file.path = directory + "/" + entry->d_name;
+        if (!parsePoseFilename(file.path, file.pose) || stat(file.path.c_str(), &status) != 0
+            || !S_ISREG(status.st_mode))
+            continue;
+        file.time = status.st_mtim.tv_sec + status.st_mtim.tv_nsec * 1e-9;
+        files.push_back(file);
+    }
+    if (dir) {
+        closedir(dir);
+        std::sort(files.begin(), files.end(), RecordedBefore());
+    }
+    LOG(INFO) << files.size() << " frames in " << directory;
+
+    for (std::size_t i = 0; i < slots.size(); ++i)
+        slots[i].ready = false;
+    if (nbDecoders == 0)
+        nbDecoders = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < nbDecoders; ++i)
+        decoders.push_back(std::thread(&ReplaySource::decode, this));
+}
+
+ReplaySource::~ReplaySource()
+{
+    {
+        std::unique_lock<std::mutex> exclusion(lock);
+        stopping = true;
+        changed.notify_all();
+    }
+    for (std::size_t i = 0; i < decoders.size(); ++i)
+        decoders[i].join();
+}
+
+void ReplaySource::setSpeed(double speed) {
+    this->speed = speed;
+}
+
+void ReplaySource::setCalibration(Calibration::Ptr calibration) {
+    this->calibration = calibration;
+}
+
+FrameBuffer::Ptr ReplaySource::next() {
+    std::unique_lock<std::mutex> exclusion(lock);
+    while (delivered < files.size()) {
+        Slot& slot = slots[delivered % slots.size()];
+        changed.wait(exclusion, [&]{ return slot.ready || stopping; });
+        if (stopping)
+            break;
+        FrameBuffer::Ptr frame;
+        frame.swap(slot.frame);
+        slot.ready = false;
+        std::size_t index = delivered++;
+        changed.notify_all();
+        if (!frame)
+            continue;
+
+        frame->sequence = index;
+        frame->calibration = calibration;
+        if (speed > 0) {
+            exclusion.unlock();
+            if (start == 0)
+                start = FrameBuffer::now() - (frame->time - files[0].time) / speed;
+            double due = start + (frame->time - files[0].time) / speed;
+            double wait = due - FrameBuffer::now();
+            if (wait > 0)
+                std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+        return frame;
+    }
+    return FrameBuffer::Ptr();
+}
+
+void ReplaySource::decode() {
+    JpegDecoder decoder;
+    std::vector<unsigned char> bytes;
+    std::unique_lock<std::mutex> exclusion(lock);
+    while (true) {
+        changed.wait(exclusion, [this]{
+            return stopping || claimed >= files.size() || claimed < delivered + slots.size();
+        });
+        if (stopping || claimed >= files.size())
+            return;
+        std::size_t index = claimed++;
+        exclusion.unlock();
+
+        const File& file = files[index];
+        FrameBuffer::Ptr frame = pool.acquire();
+        if (fromArchive ? archive.read(index, frame->image)
+            : readFile(file.path, bytes) && decoder.decode(&bytes[0], bytes.size(), frame->image, scale)) {
+            frame->pan = file.pose.pan;
+            frame->tilt = file.pose.tilt;
+            frame->zoom = file.pose.zoom;
+            frame->time = file.time;
+            frame->bgr = false;
+            frame->steady = true;
+        }
+        else {
+            LOG(ERROR) << "Error : cannot decode " << file.path;
+            frame.reset();
+        }
+
+        exclusion.lock();
+        Slot& slot = slots[index % slots.size()];
+        slot.frame = frame;
+        slot.ready = true;
+        changed.notify_all();
+    }
+}
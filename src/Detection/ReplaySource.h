@@ -0,0 +1,89 @@
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameArchive.h"
+#include "FrameBuffer.h"
+#include "PoseFilename.h"
+
+// Frames recorded in a directory, named after their pose (see
+// PoseFilename.h), given back in the order they were recorded in (that of
+// the modification times of the files) without any camera. next is a
+// DetectionPipeline::Source. The frames of an archive (see FrameArchive)
+// are replayed the same way, in the order of the archive.
+//
+// The JPEG files are read and decoded ahead by several threads, at most
+// readAhead frames in advance, and handed out in order. Frames are
+// stamped with their recorded time (FrameBuffer::time), so that the
+// tracking does not depend on the replay speed, and numbered from 0 in
+// the order of the replay (FrameBuffer::sequence).
+class ReplaySource
+{
+    public:
+        // nbDecoders = 0 means one decoder per core. scale : see
+        // JpegDecoder::decode, archived frames are not scaled.
+        ReplaySource(const std::string& directory, unsigned int nbDecoders = 0,
+                     unsigned int readAhead = 8, unsigned int scale = 1);
+        ~ReplaySource();
+
+        // Speed relative to the recording : 1 replays the frames at the
+        // pace they were recorded at, 2 twice as fast... 0 (default) hands
+        // them out as fast as they are asked for. To be called before the
+        // first frame. Files copied without keeping their modification
+        // times are all replayed at once.
+        void setSpeed(double speed);
+        // Camera the frames come from, null (default) for the standard one.
+        void setCalibration(Calibration::Ptr calibration);
+
+        // Next frame, or a null pointer once all were given. Files which
+        // cannot be decoded are skipped.
+        FrameBuffer::Ptr next();
+
+        std::size_t size() const { return files.size(); }
+        // Of the frame numbered index (FrameBuffer::sequence). For an
+        // archive, the path is the name of the file archived.
+        const std::string& path(std::size_t index) const { return files[index].path; }
+        const FramePose& pose(std::size_t index) const { return files[index].pose; }
+
+    protected:
+    private:
+        struct File {
+            std::string path;
+            FramePose pose;
+            double time;
+        };
+
+        struct Slot {
+            FrameBuffer::Ptr frame;
+            bool ready;
+        };
+
+        std::vector<File> files;
+        FrameArchive archive;
+        bool fromArchive;
+        unsigned int scale;
+        double speed;
+        Calibration::Ptr calibration;
+        FramePool pool;
+
+        std::mutex lock;
+        std::condition_variable changed;
+        // Frame i is decoded into slots[i % slots.size()].
+        std::vector<Slot> slots;
+        std::size_t claimed, delivered;
+        bool stopping;
+        // Steady clock time at which the first frame was delivered.
+        double start;
+        std::vector<std::thread> decoders;
+
+        void decode();
+
+        ReplaySource(const ReplaySource&);
+        ReplaySource& operator=(const ReplaySource&);
+};
+
+#endif // REPLAYSOURCE_H
@@ -0,0 +1,54 @@
+#include <math.h>
+#include "Reprojection.h"
+
+Reprojection::Reprojection(double pan0, double tilt0, double zoom, double u0, double v0,
+                           const Calibration& calibration)
+    :u0(u0), v0(v0), f(calibration.focal(zoom, u0))
+{
+    double beta0 = -(M_PI*pan0/180.0);
+    double alpha0 = -(M_PI*tilt0/180.0);
+    double ca = cos(alpha0), sa = sin(alpha0);
+    double cb = cos(beta0), sb = sin(beta0);
+
+    r00 = cb; r01 = sa*sb;  r02 = -ca*sb;
+    r10 = 0;  r11 = ca;     r12 = sa;
+    r20 = sb; r21 = -sa*cb; r22 = ca*cb;
+}
+
+// The ray (u - u0, v - v0, f) does not need to be normalized : the angles
+// only depend on its direction.
+void Reprojection::toPanTilt(const double* u, const double* v,
+                             double* pan, double* tilt, std::size_t n) const {
+    const double toDegrees = 180.0/M_PI;
+    for (std::size_t i = 0; i < n; ++i) {
+        double x = u[i] - u0;
+        double y = v[i] - v0;
+        double X = r00*x + r01*y + r02*f;
+        double Y = r10*x + r11*y + r12*f;
+        double Z = r20*x + r21*y + r22*f;
+        pan[i] = toDegrees*atan2(X, Z);
+        tilt[i] = -toDegrees*atan2(Y, sqrt(X*X + Z*Z));
+    }
+}
+
+void Reprojection::toPanTilt(double u, double v, double& pan, double& tilt) const {
+    toPanTilt(&u, &v, &pan, &tilt, 1);
+}
+
+bool Reprojection::toPixel(double pan, double tilt, double& u, double& v) const {
+    double beta = -(M_PI*pan/180.0);
+    double alpha = -(M_PI*tilt/180.0);
+    double X = -cos(alpha)*sin(beta);
+    double Y = sin(alpha);
+    double Z = cos(alpha)*cos(beta);
+
+    // The rotation is orthonormal : its inverse is its transpose.
+    double x = r00*X + r10*Y + r20*Z;
+    double y = r01*X + r11*Y + r21*Z;
+    double z = r02*X + r12*Y + r22*Z;
+    if (z <= 0)
+        return false;
+    u = u0 + f*x/z;
+    v = v0 + f*y/z;
+    return true;
+}
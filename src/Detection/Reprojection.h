@@ -0,0 +1,45 @@
+#ifndef REPROJECTION_H
+#define REPROJECTION_H
+
+#include <cstddef>
+#include "Calibration.h"
+
+// Pixel <-> absolute (pan, tilt) mapping of an Axis PTZ camera at a given
+// pose, as computed by Pantiltzoom/pantiltzoom.c : the (pan, tilt) that
+// would center the pixel in the image. Angles are in degrees.
+//
+// The terms depending on the pose only (focal length from the zoom, read
+// in the camera Calibration, and rotation matrix) are computed once by the
+// constructor, so that a whole frame of pixels is mapped without any
+// trigonometry but the final atan2.
+// See pages 27 to 29 of the "Traitement des Images" lecture notes for the
+// geometry.
+class Reprojection
+{
+    public:
+        // (u0, v0) is the image center, in pixels.
+        Reprojection(double pan0, double tilt0, double zoom, double u0, double v0,
+                     const Calibration& calibration);
+
+        // Batch of n pixels, given as separate arrays (pan and tilt may
+        // not alias u and v).
+        void toPanTilt(const double* u, const double* v,
+                       double* pan, double* tilt, std::size_t n) const;
+        void toPanTilt(double u, double v, double& pan, double& tilt) const;
+
+        // Inverse mapping. Returns false if the direction is behind the
+        // camera. The pixel may be outside the image.
+        bool toPixel(double pan, double tilt, double& u, double& v) const;
+
+        double focal() const { return f; }
+
+    protected:
+    private:
+        double u0, v0, f;
+        // Camera to world rotation.
+        double r00, r01, r02;
+        double r10, r11, r12;
+        double r20, r21, r22;
+};
+
+#endif // REPROJECTION_H
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <stdint.h>
+#include "SettleDetector.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Sum of (a[i] - b[i])^2 for i < n.
+uint64_t squaredDifferences(const unsigned char* a, const unsigned char* b, std::size_t n) {
+    uint64_t sum = 0;
+    std::size_t i = 0;
+#ifdef __SSE2__
+    // 16 bits differences, squared and paired by madd into 32 bits lanes,
+    // which hold at most 2 * 255^2 per 16 bytes : a row never overflows.
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+        __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+        acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    sum = (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < n; ++i) {
+        int d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+}
+
+SettleDetector::SettleDetector(unsigned int step, double tolerance, unsigned int stableFrames)
+    :step(step > 0 ? step : 1), tolerance(tolerance), stableFrames(stableFrames > 1 ? stableFrames : 2),
+     scores(), isSettled(false)
+{
+}
+
+double SettleDetector::sharpness(const unsigned char* pixels, std::size_t width, std::size_t height,
+                                 unsigned int step) {
+    if (width < 2 || height < 2)
+        return 0;
+    std::size_t rowBytes = 3 * width;
+    uint64_t sum = 0, count = 0;
+    for (std::size_t y = 0; y + 1 < height; y += step) {
+        const unsigned char* row = pixels + y * rowBytes;
+        // Each byte against the same channel of the next pixel, and of the
+        // pixel below.
+        sum += squaredDifferences(row + 3, row, rowBytes - 3);
+        sum += squaredDifferences(row + rowBytes, row, rowBytes);
+        count += 2 * rowBytes - 3;
+    }
+    return (double)sum / count;
+}
+
+void SettleDetector::reset() {
+    scores.clear();
+    isSettled = false;
+}
+
+bool SettleDetector::add(const unsigned char* pixels, std::size_t width, std::size_t height) {
+    if (scores.size() == stableFrames)
+        scores.erase(scores.begin());
+    scores.push_back(sharpness(pixels, width, height, step));
+    if (scores.size() == stableFrames) {
+        double low = *std::min_element(scores.begin(), scores.end());
+        double high = *std::max_element(scores.begin(), scores.end());
+        isSettled = high - low <= tolerance * high;
+    }
+    return isSettled;
+}
@@ -0,0 +1,45 @@
+#ifndef SETTLEDETECTOR_H
+#define SETTLEDETECTOR_H
+
+#include <cstddef>
+#include <vector>
+
+// Tells when the image of a camera is steady again after a move : the
+// autofocus has stopped hunting and the motion blur is gone.
+//
+// Each frame is given a sharpness score, and the camera is settled once
+// the scores of stableFrames consecutive frames agree within tolerance
+// (relative to the largest one). The score is the gradient energy of the
+// image, taken on one row out of step only, so that it costs a fraction of
+// a pass over the frame.
+class SettleDetector
+{
+    public:
+        SettleDetector(unsigned int step = 4, double tolerance = 0.05, unsigned int stableFrames = 3);
+
+        // Mean squared difference between neighbor pixels, horizontally
+        // and vertically, over the rows 0, step, 2 step... of a packed 24
+        // bits image. The channels are summed, so that their order does not
+        // matter and no luma plane has to be built.
+        static double sharpness(const unsigned char* pixels, std::size_t width, std::size_t height,
+                                unsigned int step);
+
+        // To be called when the camera starts moving.
+        void reset();
+        // Scores the next frame. Returns settled().
+        bool add(const unsigned char* pixels, std::size_t width, std::size_t height);
+        bool settled() const { return isSettled; }
+        // Of the last frame added.
+        double score() const { return scores.empty() ? 0 : scores.back(); }
+
+    protected:
+    private:
+        unsigned int step;
+        double tolerance;
+        unsigned int stableFrames;
+        // The last stableFrames scores at most.
+        std::vector<double> scores;
+        bool isSettled;
+};
+
+#endif // SETTLEDETECTOR_H
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include "TargetTracker.h"
+
+namespace {
+
+// Velocity of a new target is unknown : 0, give or take this many degrees
+// per second.
+const double InitialRateSigma = 30;
+
+// Cost of a pair outside the gate. Larger than any sum of gated costs, so
+// that the solver uses as few such pairs as it can.
+const double Forbidden = 1e9;
+
+}
+
+TargetTracker::TargetTracker(double measurementSigma, double accelerationSigma,
+                             double gate, unsigned int maxMisses)
+    :r(measurementSigma * measurementSigma), q(accelerationSigma * accelerationSigma),
+     gate(gate), maxMisses(maxMisses), lastTime(0), started(false),
+     current(), states(), detectionIds(), costs(), assigned()
+{
+}
+
+unsigned int TargetTracker::newId() {
+    static std::atomic<unsigned int> last(0);
+    return ++last;
+}
+
+// x += v dt, and the covariance grows by the one of a white acceleration
+// of variance q during dt.
+void TargetTracker::predict(Axis& a, double dt) const {
+    double dt2 = dt * dt;
+    a.x += a.v * dt;
+    a.p00 += dt * (2 * a.p01 + dt * a.p11) + q * dt2 * dt2 / 4;
+    a.p01 += dt * a.p11 + q * dt2 * dt / 2;
+    a.p11 += q * dt2;
+}
+
+void TargetTracker::correct(Axis& a, double innovation) const {
+    double s = a.p00 + r;
+    double k0 = a.p00 / s, k1 = a.p01 / s;
+    a.x += k0 * innovation;
+    a.v += k1 * innovation;
+    a.p11 -= k1 * a.p01;
+    a.p01 -= k0 * a.p01;
+    a.p00 -= k0 * a.p00;
+}
+
+void TargetTracker::start(Axis& a, double z) const {
+    a.x = z;
+    a.v = 0;
+    a.p00 = r;
+    a.p01 = 0;
+    a.p11 = InitialRateSigma * InitialRateSigma;
+}
+
+// Shortest augmenting paths with dual variables : O(nbRows^2 nbCols).
+void TargetTracker::assign(const std::vector<double>& costs, int nbRows, int nbCols,
+                           std::vector<int>& assigned) {
+    const double infinity = std::numeric_limits<double>::infinity();
+    // Row and column potentials, and the row of each column. Index 0 is
+    // the virtual column the path starts from, real ones are 1-based.
+    std::vector<double> u(nbRows + 1, 0), v(nbCols + 1, 0), minSlack(nbCols + 1);
+    std::vector<int> rowOf(nbCols + 1, 0), previous(nbCols + 1, 0);
+    std::vector<char> used(nbCols + 1);
+
+    for (int row = 1; row <= nbRows; ++row) {
+        rowOf[0] = row;
+        int col0 = 0;
+        std::fill(minSlack.begin(), minSlack.end(), infinity);
+        std::fill(used.begin(), used.end(), 0);
+        do {
+            used[col0] = 1;
+            int row0 = rowOf[col0], col1 = 0;
+            double delta = infinity;
+            for (int col = 1; col <= nbCols; ++col) {
+                if (used[col])
+                    continue;
+                double slack = costs[(row0 - 1) * nbCols + col - 1] - u[row0] - v[col];
+                if (slack < minSlack[col]) {
+                    minSlack[col] = slack;
+                    previous[col] = col0;
+                }
+                if (minSlack[col] < delta) {
+                    delta = minSlack[col];
+                    col1 = col;
+                }
+            }
+            for (int col = 0; col <= nbCols; ++col) {
+                if (used[col]) {
+                    u[rowOf[col]] += delta;
+                    v[col] -= delta;
+                }
+                else
+                    minSlack[col] -= delta;
+            }
+            col0 = col1;
+        } while (rowOf[col0] != 0);
+        // Flips the augmenting path.
+        do {
+            int col1 = previous[col0];
+            rowOf[col0] = rowOf[col1];
+            col0 = col1;
+        } while (col0 != 0);
+    }
+
+    assigned.assign(nbRows, -1);
+    for (int col = 1; col <= nbCols; ++col)
+        if (rowOf[col] != 0)
+            assigned[rowOf[col] - 1] = col - 1;
+}
+
+const std::vector<TargetTracker::Track>& TargetTracker::update(const std::vector<PanTiltCentered>& detections,
+                                                               double time) {
+    double dt = started ? time - lastTime : 0;
+    if (dt < 0)
+        dt = 0;
+    lastTime = time;
+    started = true;
+
+    int nbTracks = current.size(), nbDetections = detections.size();
+    for (int i = 0; i < nbTracks; ++i) {
+        predict(states[i].pan, dt);
+        predict(states[i].tilt, dt);
+        current[i].detection = -1;
+    }
+
+    // Squared Mahalanobis distances, rows being the smaller side. Pan
+    // differences are taken modulo 360.
+    bool byTrack = nbTracks <= nbDetections;
+    int nbRows = byTrack ? nbTracks : nbDetections;
+    int nbCols = byTrack ? nbDetections : nbTracks;
+    costs.resize(nbRows * nbCols);
+    for (int i = 0; i < nbTracks; ++i) {
+        const State& s = states[i];
+        double sPan = s.pan.p00 + r, sTilt = s.tilt.p00 + r;
+        for (int j = 0; j < nbDetections; ++j) {
+            double dPan = std::remainder(detections[j].first - s.pan.x, 360.0);
+            double dTilt = detections[j].second - s.tilt.x;
+            double d2 = dPan * dPan / sPan + dTilt * dTilt / sTilt;
+            costs[byTrack ? i * nbCols + j : j * nbCols + i] = d2 < gate ? d2 : Forbidden;
+        }
+    }
+    if (nbRows > 0)
+        assign(costs, nbRows, nbCols, assigned);
+
+    detectionIds.assign(nbDetections, 0);
+    std::vector<char> taken(nbDetections, 0);
+    for (int row = 0; row < nbRows; ++row) {
+        int col = assigned[row];
+        if (col < 0 || costs[row * nbCols + col] >= Forbidden)
+            continue;
+        int i = byTrack ? row : col, j = byTrack ? col : row;
+        State& s = states[i];
+        correct(s.pan, std::remainder(detections[j].first - s.pan.x, 360.0));
+        correct(s.tilt, detections[j].second - s.tilt.x);
+        s.pan.x = std::remainder(s.pan.x, 360.0);
+        Track& t = current[i];
+        ++t.hits;
+        t.misses = 0;
+        t.detection = j;
+        detectionIds[j] = t.id;
+        taken[j] = 1;
+    }
+
+    // Tracks lost for too long go, new detections come in.
+    std::size_t kept = 0;
+    for (int i = 0; i < nbTracks; ++i) {
+        if (current[i].detection < 0 && ++current[i].misses > maxMisses)
+            continue;
+        current[kept] = current[i];
+        states[kept] = states[i];
+        ++kept;
+    }
+    current.resize(kept);
+    states.resize(kept);
+    for (int j = 0; j < nbDetections; ++j) {
+        if (taken[j])
+            continue;
+        State s;
+        start(s.pan, detections[j].first);
+        start(s.tilt, detections[j].second);
+        states.push_back(s);
+        Track t;
+        t.id = newId();
+        t.hits = 1;
+        t.misses = 0;
+        t.detection = j;
+        current.push_back(t);
+        detectionIds[j] = t.id;
+    }
+
+    for (std::size_t i = 0; i < current.size(); ++i) {
+        current[i].pan = states[i].pan.x;
+        current[i].tilt = states[i].tilt.x;
+        current[i].panRate = states[i].pan.v;
+        current[i].tiltRate = states[i].tilt.v;
+    }
+    return current;
+}
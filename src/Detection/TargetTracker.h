@@ -0,0 +1,86 @@
+#ifndef TARGETTRACKER_H
+#define TARGETTRACKER_H
+
+#include <vector>
+#include "PanTiltCentered.h"
+
+// Follows the targets detected by one camera from frame to frame, and
+// gives each of them an identifier that stays the same as long as it is
+// tracked. Identifiers are unique in the process (several trackers never
+// give the same one) and start at 1, so that they can be used as labels
+// in the PositionServer.
+//
+// Each track is a constant velocity Kalman filter on pan and on tilt
+// (the two axes are independent). At each frame the tracks are predicted
+// to the frame time, a detection may only go to a track whose prediction
+// it is close to (Mahalanobis distance under gate), and the detections are
+// then shared between the tracks by solving the assignment problem
+// (Hungarian algorithm) on these distances. A detection left alone starts
+// a new track, and a track not seen for more than maxMisses frames is
+// dropped.
+class TargetTracker
+{
+    public:
+        struct Track {
+            unsigned int id;
+            double pan, tilt;             // degrees, estimated at the last update
+            double panRate, tiltRate;     // degrees per second
+            unsigned int hits;            // frames the target was seen in
+            unsigned int misses;          // frames since it was last seen
+            int detection;                // index in the last detections, -1 if missed
+
+            bool confirmed(unsigned int minHits) const { return hits >= minHits; }
+        };
+
+        // measurementSigma : detection noise, in degrees.
+        // accelerationSigma : how much a target may change its velocity, in
+        // degrees per second squared.
+        // gate : squared Mahalanobis distance, 13.8 keeps 99.9% of the
+        // detections of a target.
+        TargetTracker(double measurementSigma = 0.2, double accelerationSigma = 20,
+                      double gate = 13.8, unsigned int maxMisses = 5);
+
+        // Detections of a frame taken at time, in seconds. Returns the
+        // tracks, in the order they were created.
+        const std::vector<Track>& update(const std::vector<PanTiltCentered>& detections, double time);
+
+        const std::vector<Track>& tracks() const { return current; }
+        // Identifier of the track of each detection of the last update.
+        const std::vector<unsigned int>& ids() const { return detectionIds; }
+
+        // Minimal cost assignment of the nbRows rows of costs (nbRows x
+        // nbCols, row major, nbRows <= nbCols) to distinct columns.
+        // assigned[row] is the column of each row.
+        static void assign(const std::vector<double>& costs, int nbRows, int nbCols,
+                           std::vector<int>& assigned);
+
+    protected:
+    private:
+        // State (position, velocity) of one axis and its covariance.
+        struct Axis {
+            double x, v;
+            double p00, p01, p11;
+        };
+
+        struct State {
+            Axis pan, tilt;
+        };
+
+        double r, q, gate;
+        unsigned int maxMisses;
+        double lastTime;
+        bool started;
+        std::vector<Track> current;
+        std::vector<State> states;
+        std::vector<unsigned int> detectionIds;
+        // Assignment problem storage, kept between frames.
+        std::vector<double> costs;
+        std::vector<int> assigned;
+
+        static unsigned int newId();
+        void predict(Axis& a, double dt) const;
+        void correct(Axis& a, double innovation) const;
+        void start(Axis& a, double z) const;
+};
+
+#endif // TARGETTRACKER_H
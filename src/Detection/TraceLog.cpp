@@ -0,0 +1,177 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include "TraceLog.h"
+
+namespace TraceLog {
+
+#if NAOTRACK_TRACE_LEVEL > 0
+namespace {
+
+// Bounded multiple producers ring : each slot holds the position it
+// expects to be written at next, and the position it was written at plus
+// one once committed. The single reader frees a slot by giving it the
+// position of its next lap.
+const std::size_t capacity = 1 << 14;
+
+struct Slot {
+    std::atomic<std::size_t> sequence;
+    Record record;
+};
+
+Slot slots[capacity];
+std::atomic<std::size_t> writePosition(0);
+std::atomic<unsigned long> nbDropped(0);
+std::atomic<unsigned int> nbThreads(0);
+
+std::mutex writerLock;
+std::thread writer;
+std::atomic<bool> writing(false);
+
+struct Init {
+    Init() {
+        for (std::size_t i = 0; i < capacity; ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+} init;
+
+unsigned int threadIndex() {
+    static thread_local unsigned int index = 0;
+    if (index == 0)
+        index = ++nbThreads;
+    return index;
+}
+
+std::size_t readPosition = 0;
+std::FILE* output = 0;
+unsigned long nbReported = 0;
+
+void print(std::FILE* out, const Record& r) {
+    std::time_t seconds = r.time / 1000000000;
+    struct tm t;
+    localtime_r(&seconds, &t);
+    const char* file = std::strrchr(r.file, '/');
+    std::fprintf(out, "T%02d%02d %02d:%02d:%02d.%06d %u %s:%d] ",
+                 t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec,
+                 (int)(r.time % 1000000000 / 1000), r.thread, file ? file + 1 : r.file, r.line);
+
+    unsigned int next = 0;
+    for (const char* c = r.format; *c; ++c) {
+        if (c[0] != '{' || c[1] != '}' || next >= r.nbArgs) {
+            std::fputc(*c, out);
+            continue;
+        }
+        const Arg& a = r.args[next++];
+        switch (a.type) {
+            case Arg::Int: std::fprintf(out, "%lld", a.i); break;
+            case Arg::Unsigned: std::fprintf(out, "%llu", a.u); break;
+            case Arg::Double: std::fprintf(out, "%g", a.d); break;
+            case Arg::String: std::fputs(a.s, out); break;
+        }
+        ++c;
+    }
+    std::fputc('\n', out);
+}
+
+// Writes the records committed, returns false if there was none.
+bool drain(std::FILE* out) {
+    bool any = false;
+    while (true) {
+        Slot& slot = slots[readPosition & (capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1)
+            break;
+        print(out, slot.record);
+        slot.sequence.store(readPosition + capacity, std::memory_order_release);
+        ++readPosition;
+        any = true;
+    }
+    unsigned long lost = nbDropped.load(std::memory_order_relaxed);
+    if (lost > nbReported) {
+        std::fprintf(out, "T %lu traces dropped\n", lost - nbReported);
+        nbReported = lost;
+        any = true;
+    }
+    if (any)
+        std::fflush(out);
+    return any;
+}
+
+void writeLoop() {
+    while (writing.load(std::memory_order_acquire))
+        if (!drain(output))
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    drain(output);
+}
+
+void stopAtExit() {
+    stop();
+}
+
+}
+
+void start(std::FILE* out) {
+    std::unique_lock<std::mutex> exclusion(writerLock);
+    if (writing)
+        return;
+    static bool registered = false;
+    if (!registered)
+        std::atexit(stopAtExit);
+    registered = true;
+    output = out;
+    writing = true;
+    writer = std::thread(writeLoop);
+}
+
+void stop() {
+    std::unique_lock<std::mutex> exclusion(writerLock);
+    if (!writing)
+        return;
+    writing = false;
+    writer.join();
+}
+
+unsigned long dropped() {
+    return nbDropped.load(std::memory_order_relaxed);
+}
+
+Record* claim() {
+    std::size_t position = writePosition.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots[position & (capacity - 1)];
+        std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (sequence < position) {
+            // Not read yet since the previous lap.
+            nbDropped.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        else
+            position = writePosition.load(std::memory_order_relaxed);
+    }
+    Record& record = slots[position & (capacity - 1)].record;
+    record.position = position;
+    record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.thread = threadIndex();
+    return &record;
+}
+
+void commit(Record* record) {
+    slots[record->position & (capacity - 1)].sequence.store(record->position + 1,
+                                                             std::memory_order_release);
+}
+#else
+// Without traces, neither the ring nor the writer are linked in.
+void start(std::FILE*) {}
+void stop() {}
+unsigned long dropped() { return 0; }
+#endif
+
+}
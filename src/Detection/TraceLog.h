@@ -0,0 +1,123 @@
+#ifndef TRACELOG_H
+#define TRACELOG_H
+
+#include <cstddef>
+#include <cstdio>
+#include <stdint.h>
+
+// Trace points of the hot paths, compiled in up to the level given at
+// build time (-DNAOTRACK_TRACE_LEVEL=<level>, 0 by default) :
+//     1 TRACE_CALL()                      entry of the methods
+//     2 TRACE_FRAME(format, values...)    once per frame
+//     3 TRACE_DETAIL(format, values...)   once per blob, or more
+// Above that level, the macros compile to nothing and their arguments
+// are not evaluated.
+//
+// A trace does not format anything : the format and the values are
+// copied into a record of a lock free ring, and a background thread
+// formats and writes the records (see start). Each "{}" of the format is
+// replaced by the next value. The values are numbers, or strings which
+// outlive the program (literals, __PRETTY_FUNCTION__), at most
+// TraceLog::MaxArgs of them. When the ring is full, the traces are
+// dropped, never waited for.
+
+#ifndef NAOTRACK_TRACE_LEVEL
+#define NAOTRACK_TRACE_LEVEL 0
+#endif
+
+#if NAOTRACK_TRACE_LEVEL >= 1
+#define TRACE_CALL() TraceLog::write(__FILE__, __LINE__, "{}", __PRETTY_FUNCTION__)
+#else
+#define TRACE_CALL() do {} while (0)
+#endif
+
+#if NAOTRACK_TRACE_LEVEL >= 2
+#define TRACE_FRAME(...) TraceLog::write(__FILE__, __LINE__, __VA_ARGS__)
+#else
+#define TRACE_FRAME(...) do {} while (0)
+#endif
+
+#if NAOTRACK_TRACE_LEVEL >= 3
+#define TRACE_DETAIL(...) TraceLog::write(__FILE__, __LINE__, __VA_ARGS__)
+#else
+#define TRACE_DETAIL(...) do {} while (0)
+#endif
+
+namespace TraceLog {
+
+    enum { MaxArgs = 6 };
+
+    struct Arg {
+        enum Type { Int, Unsigned, Double, String } type;
+        union {
+            long long i;
+            unsigned long long u;
+            double d;
+            const char* s;
+        };
+    };
+
+    struct Record {
+        std::size_t position;       // in the ring, set by claim
+        int64_t time;               // nanoseconds since the epoch
+        unsigned int thread;        // in the order of their first trace
+        const char* file;
+        int line;
+        const char* format;
+        unsigned int nbArgs;
+        Arg args[MaxArgs];
+    };
+
+    // Starts the thread writing the traces to out, if traces are compiled
+    // in : the ring and its writer only exist then. The traces still in
+    // the ring are written at exit.
+    void start(std::FILE* out = stderr);
+    // Writes the traces left and stops the thread.
+    void stop();
+    // Traces lost because the ring was full.
+    unsigned long dropped();
+
+#if NAOTRACK_TRACE_LEVEL > 0
+    // Slot of the ring to fill, 0 if the ring is full. Each slot claimed
+    // must be committed.
+    Record* claim();
+    void commit(Record* record);
+
+    inline void set(Arg& a, int v) { a.type = Arg::Int; a.i = v; }
+    inline void set(Arg& a, long v) { a.type = Arg::Int; a.i = v; }
+    inline void set(Arg& a, long long v) { a.type = Arg::Int; a.i = v; }
+    inline void set(Arg& a, unsigned int v) { a.type = Arg::Unsigned; a.u = v; }
+    inline void set(Arg& a, unsigned long v) { a.type = Arg::Unsigned; a.u = v; }
+    inline void set(Arg& a, unsigned long long v) { a.type = Arg::Unsigned; a.u = v; }
+    inline void set(Arg& a, bool v) { a.type = Arg::Unsigned; a.u = v; }
+    inline void set(Arg& a, double v) { a.type = Arg::Double; a.d = v; }
+    inline void set(Arg& a, float v) { a.type = Arg::Double; a.d = v; }
+    inline void set(Arg& a, const char* v) { a.type = Arg::String; a.s = v; }
+
+    inline void fill(Record&, unsigned int) {}
+
+    template <typename T, typename... Rest>
+    void fill(Record& record, unsigned int i, const T& value, const Rest&... rest) {
+        if (i < MaxArgs) {
+            set(record.args[i], value);
+            record.nbArgs = i + 1;
+        }
+        fill(record, i + 1, rest...);
+    }
+
+    template <typename... Args>
+    void write(const char* file, int line, const char* format, const Args&... args) {
+        Record* record = claim();
+        if (!record)
+            return;
+        record->file = file;
+        record->line = line;
+        record->format = format;
+        record->nbArgs = 0;
+        fill(*record, 0, args...);
+        commit(record);
+    }
+#endif
+}
+
+#endif // TRACELOG_H
@@ -0,0 +1,175 @@
+#include <string>
+#include <cstdlib>
+#include <csignal>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <glog/logging.h>
+#include "FrameCapturer.h"
+#include "MultiCameraTracker.h"
+#include "Calibration.h"
+#include "TraceLog.h"
+
+// Tracks with all the cameras given on the command line, until SIGINT or
+// SIGTERM. The merged detections are written on stdout, one line per
+// frame :
+//     <camera> <frame> <pan> <tilt> <zoom> <nb targets> [<id> <pan> <tilt>]...
+// where <id> identifies the target as long as it is tracked, unique over
+// all the cameras (see TargetTracker), to be used as the label of the
+// points put in a PositionServer.
+//
+// The cameras calibration files are read from the directory given by -c
+// ("calibration" by default, see Calibration.h).
+//
+// The latencies of the stages of each camera (see StageLatencies) are
+// written on stderr on SIGUSR1, every -l seconds, and at the end.
+
+volatile std::sig_atomic_t stopRequested = 0;
+volatile std::sig_atomic_t reportRequested = 0;
+
+void onSignal(int) {
+    stopRequested = 1;
+}
+
+void onReportSignal(int) {
+    reportRequested = 1;
+}
+
+void reportLatencies(MultiCameraTracker& tracker) {
+    for (unsigned int i = 0; i < tracker.nbCameras(); ++i) {
+        std::ostringstream prefix;
+        prefix << "latency camera: " << i << " stage:";
+        tracker.camera(i).latencies().report(std::cerr, prefix.str());
+    }
+}
+
+void loggerInit(char* argv0) {
+    google::InitGoogleLogging(argv0);
+    FLAGS_logtostderr = 1;
+    FLAGS_minloglevel = 1;
+    TraceLog::start();
+}
+
+int main(int argc, char* argv[]) {
+    char* program = argv[0];
+    bool roi = false;
+    unsigned int pyramid = 0;
+    bool streaming = false;
+    unsigned int fps = 0;
+    bool jpeg = false;
+    unsigned int scale = 1;
+    double reportPeriod = 0;
+    while (argc > 1 && argv[1][0] == '-') {
+        std::string option(argv[1]);
+        if (option == "-c" && argc > 2) {
+            Calibration::directory = argv[2];
+            --argc;
+            ++argv;
+        }
+        else if (option == "-r")
+            roi = true;
+        else if (option == "-p" && argc > 2) {
+            pyramid = atoi(argv[2]);
+            --argc;
+            ++argv;
+        }
+        else if (option == "-s" && argc > 2) {
+            streaming = true;
+            fps = atoi(argv[2]);
+            --argc;
+            ++argv;
+        }
+        else if (option == "-j" && argc > 2) {
+            jpeg = true;
+            scale = atoi(argv[2]);
+            --argc;
+            ++argv;
+        }
+        else if (option == "-l" && argc > 2) {
+            reportPeriod = atof(argv[2]);
+            --argc;
+            ++argv;
+        }
+        else
+            break;
+        --argc;
+        ++argv;
+    }
+    argv[0] = program;
+    if (argc < 5) {
+        std::cerr << "Usage : " << argv[0]
+                  << " [-c <calibration directory>] [-r] [-p <factor>] [-s <fps>] [-j <scale>] [-l <seconds>] <username> <password> <threshold> <host[:port]>..." << std::endl
+                  << "  -r : only search around the targets found, between full frame scans" << std::endl
+                  << "  -p : first search one row out of factor (targets at least factor pixels high)" << std::endl
+                  << "  -s : read the MJPEG stream of the cameras (0 fps for their default rate)" << std::endl
+                  << "  -j : request JPEG images, decoded at 1/scale of their size (1, 2, 4 or 8)" << std::endl
+                  << "  -l : write the latencies of each stage every seconds (also on SIGUSR1)" << std::endl
+                  << "ex : " << argv[0]
+                  << " demo demo 35 192.168.50.81 192.168.50.82 192.168.50.83 192.168.50.84 192.168.50.85"
+                  << std::endl;
+        return 1;
+    }
+    loggerInit(argv[0]);
+
+    std::string user(argv[1]);
+    std::string password(argv[2]);
+    int threshold = atoi(argv[3]);
+
+    MultiCameraTracker tracker(threshold, [](const Detections& d) {
+        std::cout << d.camera << ' ' << d.sequence << ' '
+                  << d.pan << ' ' << d.tilt << ' ' << d.zoom << ' '
+                  << d.positions.size();
+        for (unsigned int i = 0; i < d.positions.size(); ++i)
+            std::cout << ' ' << d.ids[i] << ' ' << d.positions[i].first << ' ' << d.positions[i].second;
+        std::cout << std::endl;
+    });
+
+    for (int i = 4; i < argc; ++i) {
+        std::string host(argv[i]);
+        int port = 80;
+        std::string::size_type colon = host.find(':');
+        if (colon != std::string::npos) {
+            port = atoi(host.substr(colon + 1).c_str());
+            host = host.substr(0, colon);
+        }
+        tracker.addCamera(host, port, user, password);
+    }
+
+    tracker.setRoiMode(roi);
+    tracker.setPyramidMode(pyramid);
+    for (unsigned int i = 0; i < tracker.nbCameras(); ++i) {
+        tracker.camera(i).setJpegScale(scale);
+        if (streaming)
+            tracker.camera(i).setStreaming(true, fps);
+        else if (jpeg)
+            tracker.camera(i).setJpegSnapshots(true);
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::signal(SIGUSR1, onReportSignal);
+
+    tracker.start();
+    std::chrono::milliseconds period((long)(reportPeriod * 1000));
+    std::chrono::steady_clock::time_point nextReport = std::chrono::steady_clock::now() + period;
+    while (!stopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (period.count() > 0 && std::chrono::steady_clock::now() >= nextReport) {
+            reportRequested = 1;
+            nextReport += period;
+        }
+        if (reportRequested) {
+            reportRequested = 0;
+            reportLatencies(tracker);
+        }
+    }
+    tracker.stop();
+    reportLatencies(tracker);
+
+    std::cerr << "captured: " << tracker.captured()
+              << " processed: " << tracker.processed()
+              << " dropped: " << tracker.dropped()
+              << " unsteady: " << tracker.unsteady() << std::endl;
+    return 0;
+}
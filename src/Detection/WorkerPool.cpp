@@ -0,0 +1,56 @@
+#include <glog/logging.h>
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned int nbThreads)
+    :lock(), wakeUp(), tasks(), stopping(false), threads()
+{
+    if (nbThreads == 0)
+        nbThreads = std::thread::hardware_concurrency();
+    if (nbThreads == 0)
+        nbThreads = 1;
+    for (unsigned int i = 0; i < nbThreads; ++i)
+        threads.push_back(std::thread(&WorkerPool::run, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock<std::mutex> exclusion(lock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (unsigned int i = 0; i < threads.size(); ++i)
+        threads[i].join();
+}
+
+void WorkerPool::submit(Task task) {
+    {
+        std::unique_lock<std::mutex> exclusion(lock);
+        tasks.push_back(task);
+    }
+    wakeUp.notify_one();
+}
+
+void WorkerPool::run() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> exclusion(lock);
+            while (tasks.empty() && !stopping)
+                wakeUp.wait(exclusion);
+            if (tasks.empty())
+                return;
+            task = tasks.front();
+            tasks.pop_front();
+        }
+        try {
+            task();
+        }
+        catch(std::exception& e) {
+            LOG(ERROR) << "Error : " <<  e.what();
+        }
+        catch(...) {
+            LOG(ERROR) << "Unknown error";
+        }
+    }
+}
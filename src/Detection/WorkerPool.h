@@ -0,0 +1,36 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running submitted tasks in FIFO order.
+class WorkerPool
+{
+    public:
+        typedef std::function<void ()> Task;
+
+        // 0 means one thread per core.
+        WorkerPool(unsigned int nbThreads = 0);
+        // Runs the tasks already submitted, then joins the threads.
+        ~WorkerPool();
+
+        void submit(Task task);
+        unsigned int size() const { return threads.size(); }
+
+    protected:
+    private:
+        std::mutex lock;
+        std::condition_variable wakeUp;
+        std::deque<Task> tasks;
+        bool stopping;
+        std::vector<std::thread> threads;
+
+        void run();
+};
+
+#endif // WORKERPOOL_H
@@ -1,9 +1,11 @@
 #include <iostream>
 #include <cstdlib>
 #include <string>
+#include <sstream>
 #include <ctime>
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
+#include "../PositionProtocol.h"
 //#define _GLIBCXX_USE_NANOSLEEP 1
 
 typedef std::pair<double,double>  Point;  // (x,y)
@@ -19,27 +21,63 @@ double arg2d(char* arg) {
     return strtod(arg, &endptr);
 }
 
+// One mput command per round, written at once.
 void updatePoints(std::shared_ptr<boost::asio::ip::tcp::iostream> socket,
         std::vector<Data> datas, int delay, double noiseLevel) {
+    std::ostringstream command;
     while(1) {
+        command.str("");
+        command << "mput " << datas.size();
         for (auto &data : datas) {
-            *socket << "put ";
-            *socket << data.first;
-            *socket << " ";
             auto point = data.second;
-            *socket << point.first + fRand(-noiseLevel, noiseLevel);
-            *socket << " ";
-            *socket << point.second + fRand(-noiseLevel, noiseLevel);
-            *socket << " \n";
+            command << ' ' << data.first
+                    << ' ' << point.first + fRand(-noiseLevel, noiseLevel)
+                    << ' ' << point.second + fRand(-noiseLevel, noiseLevel);
         }
+        command << '\n';
+        *socket << command.str() << std::flush;
+        boost::this_thread::sleep(boost::posix_time::milliseconds(delay));
+    }
+}
+
+// Same as updatePoints, with one binary Put frame per round.
+void updatePointsBinary(std::shared_ptr<boost::asio::ip::tcp::iostream> socket,
+        std::vector<Data> datas, int delay, double noiseLevel) {
+    std::string ack;
+    *socket << "binary\n" << std::flush;
+    std::getline(*socket, ack);
+    if (ack != "binary") {
+        std::cerr << "Binary protocol refused" << std::endl;
+        return;
+    }
+
+    std::string frame;
+    while(1) {
+        frame.clear();
+        PositionProtocol::putHeader(frame, PositionProtocol::Put, datas.size());
+        for (auto &data : datas) {
+            auto point = data.second;
+            PositionProtocol::putPut(frame, data.first,
+                    point.first + fRand(-noiseLevel, noiseLevel),
+                    point.second + fRand(-noiseLevel, noiseLevel));
+        }
+        socket->write(frame.data(), frame.size());
+        socket->flush();
         boost::this_thread::sleep(boost::posix_time::milliseconds(delay));
     }
 }
 
 int main(int argc, char* argv[]) {
     //std::cout << fRand(-0.5, 0.5) << std::endl;
+    bool binary = argc > 1 && std::string(argv[1]) == "-b";
+    if (binary) {
+        argv[1] = argv[0];
+        --argc;
+        ++argv;
+    }
     if(argc%2!=1 || argc < 7) {
-        std::cerr << "Usage : " << argv[0] << " <host> <port> <delay (ms)> <noise level> <points...>" << std::endl;
+        std::cerr << "Usage : " << argv[0] << " [-b] <host> <port> <delay (ms)> <noise level> <points...>" << std::endl
+                  << "  -b : binary protocol" << std::endl;
         return 1;
     }
 
@@ -65,7 +103,7 @@ int main(int argc, char* argv[]) {
     srand(time(NULL));
     std::shared_ptr<boost::asio::ip::tcp::iostream> socket(new boost::asio::ip::tcp::iostream(host, port));
 
-    boost::thread updateThread(updatePoints, socket, datas, delay, noiseLevel);
+    boost::thread updateThread(binary ? updatePointsBinary : updatePoints, socket, datas, delay, noiseLevel);
     updateThread.join();
 
     //for (auto &data : datas) {
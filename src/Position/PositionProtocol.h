@@ -0,0 +1,116 @@
+#ifndef POSITIONPROTOCOL_H
+#define POSITIONPROTOCOL_H
+
+/*
+
+  Binary protocol of the PositionServer.
+
+  A client switches a connection to it with the text command "binary",
+  which the server acknowledges with the line "binary\n". From then on,
+  both sides only exchange frames :
+
+    header : type (u8), 3 reserved bytes (0), count (u32)
+    count records, whose size depends on the type
+
+  All the values are little-endian, doubles are IEEE 754.
+
+    Put    (client)  records : label (i32) x (f64) y (f64)          20 bytes
+    Get    (client)  no record, answered by a Points frame
+    Query  (client)  one record : since (i64, microseconds since the epoch)
+                                  label (i32) by label (u32, 0 : any label)
+                     answered by a Points frame with the points of the
+                     label put after since                          16 bytes
+    Clear  (client)  no record
+    Quit   (client)  no record, the server closes the connection
+    Subscribe (client) no record, the server then pushes a Points frame
+                     with the stored points, and the events as they come :
+                     a Points frame per put, Expire and Cleared frames
+    Points (server)  records : time (i64, microseconds since the epoch)
+                               label (i32) x (f64) y (f64)          28 bytes
+    Expire (server)  one record : time (i64), the points up to it are
+                     expired                                         8 bytes
+    Cleared (server) no record, the points were cleared
+
+  The points of a Put frame are stamped by the server with the same time,
+  and stored at once. A frame the server does not understand closes the
+  connection.
+
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace PositionProtocol {
+
+  enum Type {Put = 1, Get = 2, Clear = 3, Quit = 4, Query = 5, Subscribe = 6,
+             Points = 0x82, Expire = 0x83, Cleared = 0x84};
+
+  const std::size_t HeaderSize = 8;
+  const std::size_t PutSize    = 20;
+  const std::size_t PointSize  = 28;
+  const std::size_t QuerySize  = 16;
+  const std::size_t ExpireSize = 8;
+  const uint32_t    MaxCount   = 1 << 20;
+
+  inline void putU32(std::string& out, uint32_t v) {
+    for(int i = 0; i < 4; ++i)
+      out += (char)((v >> (8*i)) & 0xff);
+  }
+
+  inline void putU64(std::string& out, uint64_t v) {
+    for(int i = 0; i < 8; ++i)
+      out += (char)((v >> (8*i)) & 0xff);
+  }
+
+  inline void putF64(std::string& out, double d) {
+    uint64_t v;
+    std::memcpy(&v, &d, sizeof(v));
+    putU64(out, v);
+  }
+
+  inline uint32_t getU32(const unsigned char* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+  }
+
+  inline uint64_t getU64(const unsigned char* in) {
+    return (uint64_t)getU32(in) | ((uint64_t)getU32(in + 4) << 32);
+  }
+
+  inline double getF64(const unsigned char* in) {
+    uint64_t v = getU64(in);
+    double d;
+    std::memcpy(&d, &v, sizeof(d));
+    return d;
+  }
+
+  inline void putHeader(std::string& out, Type type, uint32_t count) {
+    out += (char)type;
+    out.append(3, '\0');
+    putU32(out, count);
+  }
+
+  // Size of the records of a frame type, 0 for the types without records.
+  inline std::size_t recordSize(unsigned char type) {
+    switch(type) {
+    case Put :    return PutSize;
+    case Query :  return QuerySize;
+    case Points : return PointSize;
+    case Expire : return ExpireSize;
+    default :     return 0;
+    }
+  }
+
+  inline void putPut(std::string& out, int32_t label, double x, double y) {
+    putU32(out, (uint32_t)label);
+    putF64(out, x);
+    putF64(out, y);
+  }
+
+  inline void putPoint(std::string& out, int64_t time, int32_t label, double x, double y) {
+    putU64(out, (uint64_t)time);
+    putPut(out, label, x, y);
+  }
+}
+
+#endif // POSITIONPROTOCOL_H
@@ -2,152 +2,698 @@
 
   g++ -o position-server -Wall -ansi -pedantic -O3 position-server.cc -lpthread -lboost_system-mt -std=c++11
 
+  Usage : position-server <port> <data persistance (seconds)> [<threads> [<max rate (points/s)>]]
+
+  All the connections are served by an asio event loop run by <threads>
+  threads (one per core by default). About persistance * max rate points
+  (1000 points/s by default) are kept. A "get" never waits for the "put"
+  requests : it reads a snapshot of the points.
+
+  Text protocol, one command per line :
+    put <label> <x> <y>
+    mput <n> <label> <x> <y> ...   n points put at once, with the same time
+    get                   -> <n>\n then n lines "<label> <x> <y> \n", then "end\n"
+    get [label <l>] [since <t>]
+                          -> same, for the points of label l put after t
+                             (microseconds since the epoch), then "end <t>",
+                             t being the time of the last point stored
+    clear
+    quit
+    binary                -> "binary\n", then the binary protocol of
+                             ../PositionProtocol.h for the rest of the connection
+    subscribe             -> the stored points, then the events as they come :
+                               point <label> <x> <y> <t>   point put at t
+                               expire <t>                  points up to t expired (every second)
+                               clear                       points cleared
+                             Other commands keep working, their answers are
+                             interleaved with the events. A subscriber more
+                             than 1 MB behind is disconnected.
+
 */
 
 
 #include <string>
 #include <iostream>
 #include <cstdlib>
-#include <map>
+#include <deque>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <functional>
 #include <utility>
+#include <algorithm>
 
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include <boost/asio.hpp>
 
-typedef std::pair<double,double>  Point;  // (x,y)
-typedef std::pair<int,Point>      Data;   // (label, P)
+#include "../PositionProtocol.h"
+
+#include "shared-value.h"
+
+class Session;
+
+// Sessions in push mode. The points put, the expiries and the clears are
+// formatted once per protocol and queued to every subscriber. Producers
+// store and notify under the same lock, so that a new subscriber, sent a
+// snapshot of the points, neither misses nor repeats one.
+class Subscribers {
+private:
+
+  typedef std::shared_ptr<const std::string> message;
+
+  SharedValue&                       value;
+  std::mutex                         lock;
+  std::vector<std::weak_ptr<Session> > sessions;
 
-class SharedValue {
+  // Formats the event for the protocols in use, and queues it.
+  void deliver(std::function<void (std::string&, bool)> format);
 
 public:
 
-  typedef std::map<std::chrono::system_clock::time_point,Data>   time_map;
+  Subscribers(SharedValue& val) : value(val), lock(), sessions() {}
+
+  // Stores the points, then pushes them.
+  void put(const Data* d, std::size_t n);
+  void clear(void);
+  // Pushes the horizon, if there are subscribers.
+  void expire(void);
+  // Queues the current points to session, then the new events.
+  void add(std::shared_ptr<Session> session);
+};
+
+// One client connection. Commands are whitespace separated tokens, as
+// with the former blocking iostream parsing, but read asynchronously one
+// line at a time. While an answer is being sent, the session does not
+// read further.
+//
+// The "binary" command switches the session to the framed protocol of
+// PositionProtocol.h for the rest of the connection.
+//
+// The "subscribe" command (Subscribe frame) switches the session to push
+// mode : the events are queued by the producers' threads, and written
+// while the session keeps reading commands, whose answers go through the
+// same queue. Handlers run on a strand. A subscriber with more than
+// MaxPending bytes queued is dropped instead of slowing the producers.
+class Session : public std::enable_shared_from_this<Session> {
+public:
+
+  typedef boost::asio::ip::tcp::socket socket_type;
+  typedef std::shared_ptr<const std::string> message;
+
+  static const std::size_t MaxPending = 1 << 20;
 
 private:
 
-  time_map points;
-  std::mutex lock;
+  SharedValue&            value;
+  Subscribers&            subscribers;
+  socket_type             socket;
+  boost::asio::io_service::strand strand;
+  boost::asio::streambuf  input;
+  std::deque<std::string> tokens;
+  std::string             output;
+  bool                    quitting;
+  bool                    binary;
+  bool                    subscribed;
+  bool                    ended;
+  std::vector<Data>       batch;
+
+  std::mutex              push_lock;
+  std::deque<message>     pushed;
+  std::size_t             pending;
+  bool                    writing;
+  bool                    closed;
+
+  static double toDouble(const std::string& token) {
+    char* end;
+    double d = strtod(token.c_str(), &end);
+    if(end == token.c_str() || *end != '\0')
+      throw std::invalid_argument("'" + token + "' is not a number");
+    return d;
+  }
 
-public:
+  static int toInt(const std::string& token) {
+    char* end;
+    long l = strtol(token.c_str(), &end, 10);
+    if(end == token.c_str() || *end != '\0')
+      throw std::invalid_argument("'" + token + "' is not a label");
+    return (int)l;
+  }
 
-  long int persist;
+  static long long toLong(const std::string& token) {
+    char* end;
+    long long l = strtoll(token.c_str(), &end, 10);
+    if(end == token.c_str() || *end != '\0')
+      throw std::invalid_argument("'" + token + "' is not a time");
+    return l;
+  }
 
-  SharedValue(void) : points(), lock(), persist(10) {}
-  ~SharedValue(void) {}
+  static long long microseconds(const Time& t) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+  }
 
-  time_map operator()(void) {
-    std::unique_lock<std::mutex> exclusion(lock);
+  // Text answer to a get. The filtered gets end with "end <t>", t being
+  // the time of the last point of the snapshot (or since if there is
+  // none), to be used as since by the next get.
+  void get(std::ostream& answer, const Time& since, bool by_label, int label, bool filtered) {
+    SharedValue::Snapshot points = value(since);
+    std::ostringstream lines;
+    std::size_t n = 0;
+    Time last = since;
+    for(std::size_t i = 0; i < points.size(); ++i) {
+      const Data& d = points[i].data;
+      const Point& p = d.second;
+      last = points[i].time;
+      if(by_label && d.first != label)
+	continue;
+      lines << d.first << ' ' << p.first << ' ' << p.second << ' ' << '\n';
+      ++n;
+    }
+    answer << n << '\n' << lines.str() << "end";
+    if(filtered)
+      answer << ' ' << microseconds(last);
+    answer << '\n';
+  }
 
-    std::chrono::system_clock::time_point horizon = std::chrono::system_clock::now()-std::chrono::seconds(persist);
-    time_map::iterator begin, up;
-    begin = points.begin();
-    if(begin != points.end() && (*begin).first < horizon) {
-      up = points.upper_bound(horizon);
-      points.erase(begin,up);
+  // Runs the complete commands of tokens, appending the answers to output.
+  void execute(void) {
+    std::ostringstream answer;
+    while(!tokens.empty() && !quitting && !binary) {
+      const std::string& op = tokens.front();
+      if(op == "quit")
+	quitting = true;
+      else if(op == "binary") {
+	binary = true;
+	tokens.clear();
+	answer << "binary" << '\n';
+	break;
+      }
+      else if(op == "clear")
+	subscribers.clear();
+      else if(op == "subscribe") {
+	output += answer.str();
+	answer.str("");
+	subscribe();
+      }
+      else if(op == "put") {
+	if(tokens.size() < 4)
+	  break; // arguments on the next line
+	int l    = toInt(tokens[1]);
+	double x = toDouble(tokens[2]);
+	double y = toDouble(tokens[3]);
+	Data d(l,Point(x,y));
+	subscribers.put(&d, 1);
+	tokens.erase(tokens.begin(), tokens.begin() + 4);
+	continue;
+      }
+      else if(op == "mput") {
+	if(tokens.size() < 2)
+	  break;
+	int n = toInt(tokens[1]);
+	if(n < 0 || (uint32_t)n > PositionProtocol::MaxCount)
+	  throw std::invalid_argument("'" + tokens[1] + "' is not a point count");
+	if(tokens.size() < 2 + 3*(std::size_t)n)
+	  break; // points on the next lines
+	batch.clear();
+	for(int i = 0; i < n; ++i)
+	  batch.push_back(Data(toInt(tokens[2 + 3*i]),
+			       Point(toDouble(tokens[3 + 3*i]), toDouble(tokens[4 + 3*i]))));
+	subscribers.put(batch.data(), batch.size());
+	tokens.erase(tokens.begin(), tokens.begin() + 2 + 3*n);
+	continue;
+      }
+      else if(op == "get") {
+	// Optional filters, on the same line.
+	std::size_t used = 1;
+	bool filtered = false, by_label = false;
+	int label = 0;
+	Time since;
+	while(used + 1 < tokens.size()) {
+	  if(tokens[used] == "label") {
+	    label = toInt(tokens[used + 1]);
+	    by_label = true;
+	  }
+	  else if(tokens[used] == "since")
+	    since = Time(std::chrono::microseconds(toLong(tokens[used + 1])));
+	  else
+	    break;
+	  filtered = true;
+	  used += 2;
+	}
+	get(answer, since, by_label, label, filtered);
+	tokens.erase(tokens.begin(), tokens.begin() + used);
+	continue;
+      }
+      else
+	std::cerr << "Operator '" << op << "' invalid" << std::endl;
+      tokens.pop_front();
     }
-    return points;
+    output += answer.str();
   }
 
-  SharedValue& operator+=(const Data& d) {
-    std::unique_lock<std::mutex> exclusion(lock);
-    points[std::chrono::system_clock::now()] = d;
-    return *this;
+  // Bytes still missing in input for the next frame to be complete.
+  std::size_t missing(void) const {
+    using namespace PositionProtocol;
+    std::size_t available = input.size();
+    if(available < HeaderSize)
+      return HeaderSize - available;
+    const unsigned char* header = boost::asio::buffer_cast<const unsigned char*>(input.data());
+    uint32_t count = getU32(header + 4);
+    if(count > MaxCount)
+      throw std::invalid_argument("frame too large");
+    std::size_t size = HeaderSize + count * recordSize(header[0]);
+    return size > available ? size - available : 0;
   }
 
-  void clear(void) {
-    std::unique_lock<std::mutex> exclusion(lock);
-    points.clear();
+  // Binary answer to a Get or a Query.
+  void getFrame(const Time& since, bool by_label, int label) {
+    using namespace PositionProtocol;
+    SharedValue::Snapshot points = value(since);
+    std::size_t header = output.size(), n = 0;
+    output.reserve(header + HeaderSize + points.size() * PointSize);
+    putHeader(output, Points, 0);
+    for(std::size_t i = 0; i < points.size(); ++i) {
+      const Sample& sample = points[i];
+      if(by_label && sample.data.first != label)
+	continue;
+      putPoint(output, microseconds(sample.time), sample.data.first, sample.data.second.first, sample.data.second.second);
+      ++n;
+    }
+    std::string count;
+    putU32(count, n);
+    output.replace(header + 4, 4, count);
   }
-};
 
-class ServiceThread {
-private:
+  // Runs the complete frames of input, appending the answers to output.
+  void executeFrames(void) {
+    using namespace PositionProtocol;
+    while(!quitting && missing() == 0) {
+      const unsigned char* frame = boost::asio::buffer_cast<const unsigned char*>(input.data());
+      unsigned char type = frame[0];
+      uint32_t count = getU32(frame + 4);
+      const unsigned char* record = frame + HeaderSize;
+
+      switch(type) {
+      case Put :
+	batch.clear();
+	for(uint32_t i = 0; i < count; ++i, record += PutSize)
+	  batch.push_back(Data((int32_t)getU32(record), Point(getF64(record + 4), getF64(record + 12))));
+	subscribers.put(batch.data(), batch.size());
+	break;
+      case Get :
+	getFrame(Time(), false, 0);
+	break;
+      case Query :
+	if(count != 1)
+	  throw std::invalid_argument("invalid query frame");
+	getFrame(Time(std::chrono::microseconds((int64_t)getU64(record))),
+		 getU32(record + 12) != 0, (int32_t)getU32(record + 8));
+	break;
+      case Clear :
+	subscribers.clear();
+	break;
+      case Subscribe :
+	subscribe();
+	break;
+      case Quit :
+	quitting = true;
+	break;
+      default :
+	throw std::invalid_argument("invalid frame type");
+      }
+      input.consume(HeaderSize + count * recordSize(type));
+    }
+  }
 
-  typedef boost::asio::ip::tcp::iostream socket_stream;
+  void read(void) {
+    if(binary)
+      boost::asio::async_read(socket, input, boost::asio::transfer_at_least(missing()),
+			      strand.wrap(std::bind(&Session::onFrames, shared_from_this(),
+						    std::placeholders::_1)));
+    else
+      boost::asio::async_read_until(socket, input, '\n',
+				    strand.wrap(std::bind(&Session::onRead, shared_from_this(),
+							  std::placeholders::_1, std::placeholders::_2)));
+  }
 
-  SharedValue&                      value;
-  std::shared_ptr<socket_stream>  p_socket; // Sockets streams cannot be copied....
+  // Sends output if any, then reads the next request.
+  void flush(void) {
+    if(subscribed) {
+      if(!output.empty())
+	push(message(new std::string(output)));
+      output.clear();
+      if(quitting)
+	kick(); // ends once the queue is written
+      else
+	read();
+    }
+    else if(!output.empty())
+      boost::asio::async_write(socket, boost::asio::buffer(output),
+			       strand.wrap(std::bind(&Session::onWrite, shared_from_this(),
+						     std::placeholders::_1)));
+    else if(quitting)
+      end("quit");
+    else
+      read();
+  }
 
-public:
+  void subscribe(void) {
+    if(subscribed)
+      return;
+    subscribed = true;
+    if(!output.empty())
+      push(message(new std::string(output)));
+    output.clear();
+    subscribers.add(shared_from_this());
+  }
 
-  ServiceThread(SharedValue& val,
-		boost::asio::ip::tcp::acceptor& acceptor)
-    : value(val), p_socket(new socket_stream()) {
-    acceptor.accept(*(p_socket->rdbuf()));
+  // Starts writing the queue, if it is not already.
+  void kick(void) {
+    std::unique_lock<std::mutex> exclusion(push_lock);
+    if(!writing) {
+      writing = true;
+      strand.post(std::bind(&Session::writePushed, shared_from_this()));
+    }
   }
 
-  // This is called internally at thread creation.
-  ServiceThread(const ServiceThread& cp)
-    : value(cp.value), p_socket(cp.p_socket) {
+  void writePushed(void) {
+    message next;
+    {
+      std::unique_lock<std::mutex> exclusion(push_lock);
+      if(pushed.empty()) {
+	writing = false;
+	exclusion.unlock();
+	if(quitting)
+	  end("quit");
+	return;
+      }
+      next = pushed.front();
+    }
+    boost::asio::async_write(socket, boost::asio::buffer(*next),
+			     strand.wrap(std::bind(&Session::onPushed, shared_from_this(),
+						   next, std::placeholders::_1)));
   }
 
-  ~ServiceThread(void) {
+  // written is kept alive until the write is over.
+  void onPushed(message written, const boost::system::error_code& error) {
+    if(ended)
+      return;
+    if(error) {
+      end(error.message());
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> exclusion(push_lock);
+      pending -= pushed.front()->size();
+      pushed.pop_front();
+    }
+    writePushed();
   }
 
-  void operator()(void) {
-    std::string op;
-    double x,y;
-    int l;
-    socket_stream& socket = *p_socket;
+  void onFrames(const boost::system::error_code& error) {
+    if(error) {
+      end(error.message());
+      return;
+    }
 
     try {
-      socket.exceptions(std::ios::failbit | std::ios::badbit | std::ios::eofbit);
-      while(true) {
-	socket >> op;
-	if(op == "quit")
-	  break;
-	if(op == "clear")
-	  value.clear();
-	else if(op == "put") {
-	  socket >> l >> x >> y;
-	  value += Data(l,Point(x,y));
-	}
-	else if(op == "get") {
-	  SharedValue::time_map::iterator iter,end;
-	  SharedValue::time_map points = value();
-	  socket << points.size() << std::endl;
-	  for(iter=points.begin(), end=points.end(); iter != end; ++iter) {
-	    Data& d = (*iter).second;
-	    Point& p = d.second;
-	    socket << d.first << ' ' << p.first << ' ' << p.second << ' ' << std::endl;
-	  }
-      socket << "end" << std::endl;
-	}
-	else
-	  std::cerr << "Operator '" << op << "' invalid" << std::endl;
-      }
+      executeFrames();
+    }
+    catch(std::exception& e) {
+      end(e.what());
+      return;
+    }
+    flush();
+  }
+
+  void onRead(const boost::system::error_code& error, std::size_t length) {
+    if(error) {
+      end(error.message());
+      return;
+    }
+
+    std::istream line(&input);
+    std::string data(length, '\0');
+    line.read(&data[0], length);
+    std::istringstream words(data);
+    std::string word;
+    while(words >> word)
+      tokens.push_back(word);
+
+    try {
+      execute();
+      // Frames sent right after the "binary" command may already be there.
+      if(binary)
+	executeFrames();
     }
     catch(std::exception& e) {
-      std::cout << "Exception : " << e.what() << std::endl;
+      end(e.what());
+      return;
+    }
+    flush();
+  }
+
+  void onWrite(const boost::system::error_code& error) {
+    output.clear();
+    if(error)
+      end(error.message());
+    else if(quitting)
+      end("quit");
+    else
+      read();
+  }
+
+  void end(const std::string& reason) {
+    if(ended)
+      return;
+    ended = true;
+    {
+      std::unique_lock<std::mutex> exclusion(push_lock);
+      closed = true;
+      pushed.clear();
+    }
+    boost::system::error_code ignored;
+    socket.close(ignored);
+    std::cout << "End of session (" << reason << ")" << std::endl;
+  }
+
+public:
+
+  Session(SharedValue& val, Subscribers& subs, boost::asio::io_service& ios)
+    : value(val), subscribers(subs), socket(ios), strand(ios), input(), tokens(), output(),
+      quitting(false), binary(false), subscribed(false), ended(false), batch(),
+      push_lock(), pushed(), pending(0), writing(false), closed(false) {
+  }
+
+  socket_type& getSocket(void) {return socket;}
+
+  bool isBinary(void) const {return binary;}
+
+  // Queues m to be written, from any thread. Returns false if the session
+  // is closed, or has just been dropped because it is too slow.
+  bool push(const message& m) {
+    std::unique_lock<std::mutex> exclusion(push_lock);
+    if(closed)
+      return false;
+    if(pending + m->size() > MaxPending) {
+      closed = true;
+      strand.post(std::bind(&Session::end, shared_from_this(), std::string("subscriber too slow")));
+      return false;
     }
+    pushed.push_back(m);
+    pending += m->size();
+    if(!writing) {
+      writing = true;
+      strand.post(std::bind(&Session::writePushed, shared_from_this()));
+    }
+    return true;
+  }
 
-    std::cout << "End of thread (client disconnects)" << std::endl;
+  void start(void) {
+    read();
+  }
+};
+
+void Subscribers::deliver(std::function<void (std::string&, bool)> format) {
+  message text, binary;
+  std::vector<std::weak_ptr<Session> >::iterator it = sessions.begin();
+  while(it != sessions.end()) {
+    std::shared_ptr<Session> session = it->lock();
+    bool delivered = false;
+    if(session) {
+      message& m = session->isBinary() ? binary : text;
+      if(!m) {
+	std::string* content = new std::string();
+	m.reset(content);
+	format(*content, session->isBinary());
+      }
+      delivered = session->push(m);
+    }
+    if(delivered)
+      ++it;
+    else
+      it = sessions.erase(it);
+  }
+}
+
+void Subscribers::put(const Data* d, std::size_t n) {
+  std::unique_lock<std::mutex> exclusion(lock);
+  Time time = value.put(d, n);
+  if(sessions.empty())
+    return;
+  long long t = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+  deliver([d, n, t](std::string& out, bool binary) {
+      if(binary) {
+	PositionProtocol::putHeader(out, PositionProtocol::Points, n);
+	for(std::size_t i = 0; i < n; ++i)
+	  PositionProtocol::putPoint(out, t, d[i].first, d[i].second.first, d[i].second.second);
+      }
+      else {
+	std::ostringstream lines;
+	for(std::size_t i = 0; i < n; ++i)
+	  lines << "point " << d[i].first << ' ' << d[i].second.first << ' ' << d[i].second.second
+		<< ' ' << t << '\n';
+	out = lines.str();
+      }
+    });
+}
+
+void Subscribers::clear(void) {
+  std::unique_lock<std::mutex> exclusion(lock);
+  value.clear();
+  if(sessions.empty())
+    return;
+  deliver([](std::string& out, bool binary) {
+      if(binary)
+	PositionProtocol::putHeader(out, PositionProtocol::Cleared, 0);
+      else
+	out = "clear\n";
+    });
+}
+
+void Subscribers::expire(void) {
+  std::unique_lock<std::mutex> exclusion(lock);
+  if(sessions.empty())
+    return;
+  long long t = std::chrono::duration_cast<std::chrono::microseconds>(value.horizon().time_since_epoch()).count();
+  deliver([t](std::string& out, bool binary) {
+      if(binary) {
+	PositionProtocol::putHeader(out, PositionProtocol::Expire, 1);
+	PositionProtocol::putU64(out, t);
+      }
+      else {
+	std::ostringstream line;
+	line << "expire " << t << '\n';
+	out = line.str();
+      }
+    });
+}
+
+void Subscribers::add(std::shared_ptr<Session> session) {
+  std::unique_lock<std::mutex> exclusion(lock);
+  SharedValue::Snapshot points = value();
+  std::ostringstream out;
+  std::string frame;
+  if(session->isBinary())
+    PositionProtocol::putHeader(frame, PositionProtocol::Points, points.size());
+  for(std::size_t i = 0; i < points.size(); ++i) {
+    const Sample& sample = points[i];
+    long long t = std::chrono::duration_cast<std::chrono::microseconds>(sample.time.time_since_epoch()).count();
+    if(session->isBinary())
+      PositionProtocol::putPoint(frame, t, sample.data.first, sample.data.second.first, sample.data.second.second);
+    else
+      out << "point " << sample.data.first << ' ' << sample.data.second.first << ' '
+	  << sample.data.second.second << ' ' << t << '\n';
+  }
+  if(!session->isBinary())
+    frame = out.str();
+  if(frame.empty() || session->push(message(new std::string(frame))))
+    sessions.push_back(session);
+}
+
+class Server {
+private:
+
+  SharedValue&                   value;
+  Subscribers                    subscribers;
+  boost::asio::io_service&       ios;
+  boost::asio::ip::tcp::acceptor acceptor;
+  boost::asio::deadline_timer    expiry;
+
+  void accept(void) {
+    std::shared_ptr<Session> session(new Session(value, subscribers, ios));
+    acceptor.async_accept(session->getSocket(),
+			  std::bind(&Server::onAccept, this, session,
+				    std::placeholders::_1));
+  }
+
+  void onAccept(std::shared_ptr<Session> session, const boost::system::error_code& error) {
+    if(!error)
+      session->start();
+    else
+      std::cerr << "Accept : " << error.message() << std::endl;
+    accept();
+  }
+
+  // The subscribers are told the horizon every second.
+  void tick(void) {
+    expiry.expires_from_now(boost::posix_time::seconds(1));
+    expiry.async_wait(std::bind(&Server::onTick, this, std::placeholders::_1));
+  }
+
+  void onTick(const boost::system::error_code& error) {
+    if(error)
+      return;
+    subscribers.expire();
+    tick();
+  }
+
+public:
+
+  Server(SharedValue& val, boost::asio::io_service& service, int port)
+    : value(val), subscribers(val), ios(service),
+      acceptor(service, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)),
+      expiry(service) {
+    accept();
+    tick();
   }
 };
 
 
 int main(int argc, char* argv[]) {
-  if(argc!=3) {
-    std::cerr << "Usage : " << argv[0] << " <port> <data persistance (seconds)>" << std::endl;
+  if(argc<3 || argc>5) {
+    std::cerr << "Usage : " << argv[0] << " <port> <data persistance (seconds)> [<threads> [<max rate (points/s)>]]" << std::endl;
     return 1;
   }
 
   try {
     boost::asio::io_service        ios;
-    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::v4(), atoi(argv[1]));
-    boost::asio::ip::tcp::acceptor acceptor(ios, endpoint);
     SharedValue                    shared_value;
+    unsigned int                   nb_threads = std::thread::hardware_concurrency();
+    long int                       max_rate   = 1000;
 
     shared_value.persist = atoi(argv[2]);
-
-    std::cout << "PositionServer is started..." << std::endl;
-    while(true) {
-      std::thread service(ServiceThread(shared_value,acceptor));
-      service.detach();
-    }
+    if(argc >= 4)
+      nb_threads = atoi(argv[3]);
+    if(nb_threads == 0)
+      nb_threads = 1;
+    if(argc == 5)
+      max_rate = atol(argv[4]);
+    shared_value.setCapacity(shared_value.persist * max_rate);
+
+    Server server(shared_value, ios, atoi(argv[1]));
+
+    std::cout << "PositionServer is started (" << nb_threads << " threads, "
+	      << shared_value.capacity() << " points max)..." << std::endl;
+    std::vector<std::thread> pool;
+    for(unsigned int i = 1; i < nb_threads; ++i)
+      pool.push_back(std::thread([&ios]() {ios.run();}));
+    ios.run();
+    for(unsigned int i = 0; i < pool.size(); ++i)
+      pool[i].join();
   }
   catch(std::exception& e) {
     std::cerr << e.what() << std::endl;
@@ -0,0 +1,262 @@
+#ifndef SHARED_VALUE_H
+#define SHARED_VALUE_H
+
+// Storage of the points of the position server, shared by its sessions
+// (see position-server.cc).
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+typedef std::pair<double,double>  Point;  // (x,y)
+typedef std::pair<int,Point>      Data;   // (label, P)
+
+typedef std::chrono::system_clock::time_point Time;
+
+struct Sample {
+  Time time;
+  Data data;
+};
+
+// Points of the last <persist> seconds, appended in time order to fixed
+// size chunks. A sample is never modified once written, so readers do not
+// lock : they take a Snapshot of the chunk list, published by the writers
+// through an atomic shared_ptr each time a chunk is added or dropped, and
+// read the points straight from the chunks. The size of the last chunk is
+// published with a release store once all the points of a put are
+// written, and a chunk list once its points are : a snapshot has all the
+// points of a put, or none.
+//
+// Writers are serialized by a mutex, which readers never take. Expired
+// chunks are dropped by the writers, and recycled once no snapshot refers
+// to them anymore. The capacity is checked a chunk at a time : when the
+// points do not fit in capacity points rounded up to whole chunks, plus
+// the chunk being filled, the oldest chunk is dropped. The chunks are
+// allocated by setCapacity, with ReaderMargin more for the ones still
+// held by snapshots, so that writers only allocate when readers hold
+// more than that.
+//
+// The times stored are whole microseconds, the precision of the protocol,
+// and each put gets a later time than the previous one, even when the
+// system clock is set back or two puts come in the same microsecond :
+// the points are searched by time and expire in order, and asking for the
+// points after the time of a point returns exactly the ones put after it.
+class SharedValue {
+
+public:
+
+  enum {ChunkSize = 256, ReaderMargin = 4};
+
+  struct Chunk {
+    Sample samples[ChunkSize];
+    std::atomic<std::size_t> filled;
+  };
+
+private:
+
+  typedef std::shared_ptr<Chunk> chunk_ptr;
+
+  // Every chunk but the last one is full.
+  struct List {
+    std::vector<chunk_ptr> chunks;
+  };
+
+  std::shared_ptr<const List> current; // accessed through std::atomic_load/store only
+  std::deque<chunk_ptr> spare;
+  std::size_t max_points, max_chunks, max_spare;
+  std::atomic<Time::rep> latest; // time of the last point stored
+  unsigned long overwritten;
+  std::mutex lock;
+
+  Time horizon(const Time& now) const {
+    return now - std::chrono::seconds(persist);
+  }
+
+  // The system time, or the time of the last point if it is later.
+  Time clock(void) const {
+    Time last(Time::duration(latest.load(std::memory_order_relaxed)));
+    return std::max(std::chrono::system_clock::now(), last);
+  }
+
+  chunk_ptr newChunk(void) {
+    for(std::deque<chunk_ptr>::iterator it = spare.begin(); it != spare.end(); ++it)
+      if(it->use_count() == 1) {
+	// The last snapshot using it is gone, see the reader's writes.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	chunk_ptr chunk = *it;
+	spare.erase(it);
+	chunk->filled.store(0, std::memory_order_relaxed);
+	return chunk;
+      }
+    // Every spare chunk is still read.
+    chunk_ptr chunk(new Chunk());
+    chunk->filled.store(0, std::memory_order_relaxed);
+    return chunk;
+  }
+
+  void retire(const chunk_ptr& chunk) {
+    spare.push_back(chunk);
+    if(spare.size() > max_spare)
+      spare.pop_front(); // still read, freed by its last snapshot
+  }
+
+  void publish(std::shared_ptr<const List> list) {
+    std::atomic_store(&current, list);
+  }
+
+  // List, whose last chunk is full, with a new empty chunk and without the
+  // expired chunks, to be published.
+  std::shared_ptr<const List> roll(std::shared_ptr<const List> list, const Time& now) {
+    Time limit = horizon(now);
+    std::shared_ptr<List> next(new List());
+    std::vector<chunk_ptr>::const_iterator it = list->chunks.begin();
+    for(; it != list->chunks.end(); ++it) {
+      if((*it)->samples[ChunkSize - 1].time > limit)
+	break;
+      retire(*it);
+    }
+    next->chunks.assign(it, list->chunks.end());
+    if(next->chunks.size() + 1 > max_chunks) {
+      const Chunk& oldest = *next->chunks.front();
+      for(std::size_t i = 0; i < ChunkSize; ++i)
+	if(oldest.samples[i].time > limit)
+	  ++overwritten;
+      retire(next->chunks.front());
+      next->chunks.erase(next->chunks.begin());
+    }
+    next->chunks.push_back(newChunk());
+    return next;
+  }
+
+public:
+
+  // Points of the list when taken, without the expired ones. Holding a
+  // snapshot keeps its chunks alive.
+  class Snapshot {
+    friend class SharedValue;
+    std::shared_ptr<const List> list;
+    std::size_t first, last;
+  public:
+    std::size_t size(void) const {return last - first;}
+    const Sample& operator[](std::size_t i) const {
+      std::size_t j = first + i;
+      return list->chunks[j / ChunkSize]->samples[j % ChunkSize];
+    }
+  };
+
+  long int persist;
+
+  SharedValue(void)
+    : current(), spare(), max_points(0), max_chunks(0), max_spare(0), latest(Time().time_since_epoch().count()),
+      overwritten(0), lock(), persist(10) {
+    setCapacity(ChunkSize);
+  }
+  ~SharedValue(void) {}
+
+  // Drops the current points.
+  void setCapacity(std::size_t capacity) {
+    std::size_t points = capacity > 0 ? capacity : 1;
+    std::size_t chunks = (points + ChunkSize - 1) / ChunkSize + 1;
+    std::deque<chunk_ptr> pool;
+    for(std::size_t i = 0; i < chunks + ReaderMargin; ++i)
+      pool.push_back(chunk_ptr(new Chunk()));
+
+    std::unique_lock<std::mutex> exclusion(lock);
+    max_points = points;
+    max_chunks = chunks;
+    max_spare = pool.size();
+    spare.swap(pool); // the previous chunks are freed by their last snapshot
+    std::shared_ptr<List> list(new List());
+    list->chunks.push_back(newChunk());
+    publish(list);
+  }
+
+  std::size_t capacity(void) const {return max_points;}
+
+  // The points up to this time are expired.
+  Time horizon(void) const {return horizon(clock());}
+
+  // Number of unexpired points dropped because there were too many.
+  unsigned long lost(void) {
+    std::unique_lock<std::mutex> exclusion(lock);
+    return overwritten;
+  }
+
+  // Points after since, if it is later than the horizon.
+  Snapshot operator()(const Time& since = Time()) const {
+    Snapshot snapshot;
+    snapshot.list = std::atomic_load(&current);
+    const std::vector<chunk_ptr>& chunks = snapshot.list->chunks;
+    snapshot.last = (chunks.size() - 1) * ChunkSize
+      + chunks.back()->filled.load(std::memory_order_acquire);
+
+    // First point after since and the horizon.
+    Time limit = std::max(since, horizon(clock()));
+    std::size_t lo = 0, hi = snapshot.last;
+    while(lo < hi) {
+      std::size_t mid = lo + (hi - lo) / 2;
+      if(chunks[mid / ChunkSize]->samples[mid % ChunkSize].time <= limit)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+    snapshot.first = lo;
+    return snapshot;
+  }
+
+  // Appends the n points with the same time, under one lock, and returns
+  // this time.
+  Time put(const Data* d, std::size_t n) {
+    std::unique_lock<std::mutex> exclusion(lock);
+    Time now = std::chrono::time_point_cast<std::chrono::microseconds>(std::chrono::system_clock::now());
+    Time last(Time::duration(latest.load(std::memory_order_relaxed)));
+    if(now <= last)
+      now = last + std::chrono::microseconds(1);
+    latest.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    std::shared_ptr<const List> published = std::atomic_load(&current);
+    std::shared_ptr<const List> list = published;
+    Chunk* tail = list->chunks.back().get();
+    std::size_t filled = tail->filled.load(std::memory_order_relaxed);
+
+    // The readers of the published list see the size of its last chunk
+    // before this put, until the new list is published.
+    for(std::size_t k = 0; k < n; ++k) {
+      if(filled == ChunkSize) {
+	list = roll(list, now);
+	tail = list->chunks.back().get();
+	filled = 0;
+      }
+      Sample& sample = tail->samples[filled++];
+      sample.time = now;
+      sample.data = d[k];
+    }
+    tail->filled.store(filled, std::memory_order_release);
+    if(list != published)
+      publish(list);
+    return now;
+  }
+
+  SharedValue& operator+=(const Data& d) {
+    put(&d, 1);
+    return *this;
+  }
+
+  void clear(void) {
+    std::unique_lock<std::mutex> exclusion(lock);
+    std::shared_ptr<const List> list = std::atomic_load(&current);
+    for(std::size_t i = 0; i < list->chunks.size(); ++i)
+      retire(list->chunks[i]);
+    std::shared_ptr<List> next(new List());
+    next->chunks.push_back(newChunk());
+    publish(next);
+  }
+};
+
+#endif // SHARED_VALUE_H